@@ -26,6 +26,7 @@
 #include <map>
 #include <utility>
 #include <memory>
+#include "diagnostic_msgs/msg/diagnostic_array.hpp"
 #include "geometry_msgs/msg/pose_array.hpp"
 #include "geometry_msgs/msg/pose_stamped.hpp"
 #include "message_filters/subscriber.h"
@@ -43,11 +44,11 @@
 #include "nav2_util/sensors/laser/laser.hpp"
 #include "nav2_util/motion_model/motion_model.hpp"
 #include "nav2_util/angleutils.hpp"
+#include "nav2_util/latency_stats.hpp"
+#include "nav2_util/worker_pool.hpp"
 #include "rclcpp/parameter_events_filter.hpp"
 #include "nav2_dynamic_params/dynamic_params_client.hpp"
 
-#define NEW_UNIFORM_SAMPLING 1
-
 // Pose hypothesis
 typedef struct
 {
@@ -71,6 +72,8 @@ public:
 private:
   void updatePoseFromServer();
   void checkLaserReceived();
+  void publishDiagnostics();
+  double effectiveSampleSize();
   void requestMap();
   void createMotionModel();
   nav2_util::Laser * createLaserObject();
@@ -90,12 +93,16 @@ private:
     std::shared_ptr<nav_msgs::srv::SetMap::Response> res);
 
   void laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan);
+  bool lasersReady(const tf2::TimePoint & stamp);
+  void publishParticleCloud();
   void initialPoseReceived(geometry_msgs::msg::PoseWithCovarianceStamped::SharedPtr msg);
   void handleInitialPoseMessage(const geometry_msgs::msg::PoseWithCovarianceStamped & msg);
   void mapReceived(const nav_msgs::msg::OccupancyGrid::SharedPtr msg);
   void handleMapMessage(const nav_msgs::msg::OccupancyGrid & msg);
+  bool updateMapInPlace(const nav_msgs::msg::OccupancyGrid & msg);
   void freeMapDependentMemory();
   map_t * convertMap(const nav_msgs::msg::OccupancyGrid & map_msg);
+  void updateCspace();
   void applyInitialPose();
 
   // Helper to get odometric pose from transform system
@@ -132,10 +139,6 @@ private:
   // the map
   static pf_vector_t uniformPoseGenerator(void * arg);
 
-#if NEW_UNIFORM_SAMPLING
-  static std::vector<std::pair<int, int>> free_space_indices;
-#endif
-
   // Parameter for what odom to use
   std::string odom_frame_id_;
 
@@ -148,6 +151,8 @@ private:
 
   bool use_map_topic_;
   bool first_map_only_;
+  // Apply a new map with the same geometry to the current one, keeping the filter
+  bool update_map_in_place_;
 
   tf2::TimePoint save_pose_last_time;
   tf2::Duration save_pose_period;
@@ -161,8 +166,17 @@ private:
 
   std::vector<nav2_util::Laser *> lasers_;
   std::vector<bool> lasers_update_;
+  // Lasers with a scan waiting in lasers_data_ to weigh the particles
+  std::vector<bool> lasers_pending_;
+  std::vector<std::unique_ptr<nav2_util::LaserData>> lasers_data_;
   std::map<std::string, int> frame_to_laser_;
 
+  // Scans of different lasers taken within this many seconds weigh the particles
+  // together, followed by a single resample; 0 to update on every scan
+  double laser_fusion_window_;
+  // Stamp of the first pending scan
+  tf2::TimePoint fusion_start_;
+
   // Particle filter
   pf_t * pf_;
   double pf_err_;
@@ -185,7 +199,13 @@ private:
   std::string robot_model_type_;
   std::string sensor_model_type_;
 
+  // The particle cloud is published at most once per interval (always if zero),
+  // with at most particlecloud_max_size_ particles (all if not positive). The
+  // mode is "particles", or "clusters" to publish the cluster means instead.
   std::chrono::duration<double> cloud_pub_interval;
+  tf2::TimePoint cloud_last_publish_time_;
+  int particlecloud_max_size_;
+  std::string particlecloud_mode_;
 
   // Time for tolerance on the published transform,
   // basically defines how long a map->odom transform is good for
@@ -207,6 +227,23 @@ private:
   std::chrono::seconds laser_check_interval_;
   rclcpp::TimerBase::SharedPtr check_laser_timer_;
 
+  // Performance counters of the filter, published on the diagnostics topic
+  // every diagnostics_period_ seconds (never if not positive)
+  double diagnostics_period_;
+  rclcpp::TimerBase::SharedPtr diagnostics_timer_;
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnostics_pub_;
+  nav2_util::LatencyStats motion_stats_;
+  nav2_util::LatencyStats sensor_stats_;
+  nav2_util::LatencyStats resample_stats_;
+  nav2_util::LatencyStats cluster_stats_;
+  nav2_util::LatencyStats cloud_stats_;
+  nav2_util::LatencyStats pose_stats_;
+  uint64_t scans_received_;
+  uint64_t scans_processed_;
+  uint64_t scans_skipped_;
+  uint64_t scans_dropped_;
+  double effective_sample_size_;
+
   int max_beams_;
   int min_particles_;
   int max_particles_;
@@ -234,6 +271,20 @@ private:
   double beam_skip_error_threshold_;
   double laser_likelihood_max_dist_;
 
+  // Pick the most informative beams of each scan rather than a fixed stride
+  bool adaptive_beam_selection_;
+
+  // Threads used to weigh the particles in the sensor update, 0 for one per core
+  int sensor_threads_;
+  std::shared_ptr<nav2_util::WorkerPool> sensor_pool_;
+
+  // Seed of the random number generators, negative to seed from the clock
+  int random_seed_;
+
+  // Directory where the cspace distances of the likelihood field models are
+  // cached across restarts, empty to disable the cache
+  std::string cspace_cache_dir_;
+
   std::string odom_model_type_;
   std::string laser_model_type_;
 
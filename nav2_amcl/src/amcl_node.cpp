@@ -20,6 +20,7 @@
 
 /* Author: Brian Gerkey */
 
+#include <cstdio>
 #include <memory>
 #include <string>
 #include <utility>
@@ -28,6 +29,7 @@
 #include "nav2_amcl/amcl_node.hpp"
 #include "nav2_util/pf/pf.hpp"  // pf_vector_t
 #include "nav2_util/strutils.hpp"
+#include "nav2_util/execution_timer.hpp"
 #include "nav2_tasks/map_service_client.hpp"
 
 // For transform support
@@ -64,9 +66,17 @@ using namespace std::chrono_literals;
 
 static const char scan_topic_[] = "scan";
 
-#if NEW_UNIFORM_SAMPLING
-std::vector<std::pair<int, int>> AmclNode::free_space_indices;
-#endif
+// Occupancy state of a map cell (-1 = free, 0 = unknown, +1 = occ) from its
+// OccupancyGrid value
+static int8_t occupancyToState(int8_t value)
+{
+  if (value == 0) {
+    return -1;
+  } else if (value == 100) {
+    return +1;
+  }
+  return 0;
+}
 
 AmclNode::AmclNode()
 : Node("amcl"),
@@ -79,7 +89,12 @@ AmclNode::AmclNode()
   laser_(NULL),
   initial_pose_hyp_(NULL),
   first_map_received_(false),
-  first_reconfigure_call_(true)
+  first_reconfigure_call_(true),
+  scans_received_(0),
+  scans_processed_(0),
+  scans_skipped_(0),
+  scans_dropped_(0),
+  effective_sample_size_(0.0)
 {
   RCLCPP_INFO(get_logger(), "Initializing AMCL");
   std::lock_guard<std::recursive_mutex> l(configuration_mutex_);
@@ -88,6 +103,8 @@ AmclNode::AmclNode()
 
   initAmclParams();
 
+  sensor_pool_ = std::make_shared<nav2_util::WorkerPool>(std::max(sensor_threads_, 0));
+
   dynamic_param_client_ = std::make_unique<nav2_dynamic_params::DynamicParamsClient>(node_);
 
   createMotionModel();
@@ -164,8 +181,10 @@ AmclNode::AmclNode()
       "min_particles", "max_particles", "pf_err",
       "pf_z", "alpha1", "alpha2", "alpha3", "alpha4", "alpha5",
       "do_beamskip", "beam_skip_distance", "beam_skip_threshold",
-      "beam_skip_error_threshold", "z_hit", "z_short", "z_max",
-      "z_rand", "sigma_hit", "lambda_short",
+      "beam_skip_error_threshold", "adaptive_beam_selection", "laser_fusion_window",
+      "particlecloud_max_rate", "particlecloud_max_size", "particlecloud_mode",
+      "update_map_in_place",
+      "z_hit", "z_short", "z_max", "z_rand", "sigma_hit", "lambda_short",
       "laser_likelihood_max_dist", "laser_model_type",
       "robot_model_type", "update_min_d", "update_min_a",
       "odom_frame_id", "base_frame_id", "global_frame_id",
@@ -177,6 +196,12 @@ AmclNode::AmclNode()
   laser_check_interval_ = 15s;
   check_laser_timer_ =
     create_wall_timer(laser_check_interval_, std::bind(&AmclNode::checkLaserReceived, this));
+
+  diagnostics_pub_ = create_publisher<diagnostic_msgs::msg::DiagnosticArray>("diagnostics");
+  if (diagnostics_period_ > 0.0) {
+    diagnostics_timer_ = create_wall_timer(std::chrono::duration<double>(diagnostics_period_),
+        std::bind(&AmclNode::publishDiagnostics, this));
+  }
   RCLCPP_INFO(get_logger(), "AMCL Initialization complete");
 }
 
@@ -303,6 +328,80 @@ AmclNode::checkLaserReceived()
   }
 }
 
+/**
+ * Publish the performance counters of the filter: latency percentiles of
+ * each phase of a laser update, the particle count and effective sample
+ * size, and how many scans were used, skipped or dropped.
+ */
+void
+AmclNode::publishDiagnostics()
+{
+  std::lock_guard<std::recursive_mutex> l(configuration_mutex_);
+
+  diagnostic_msgs::msg::DiagnosticStatus status;
+  status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+  status.name = std::string(get_name()) + ": localization performance";
+  status.message = "Filter running";
+
+  auto add_value = [&status](const std::string & key, const std::string & value) {
+      diagnostic_msgs::msg::KeyValue kv;
+      kv.key = key;
+      kv.value = value;
+      status.values.push_back(kv);
+    };
+
+  const std::pair<const char *, const nav2_util::LatencyStats *> phases[] = {
+    {"motion update", &motion_stats_},
+    {"sensor update", &sensor_stats_},
+    {"resample", &resample_stats_},
+    {"cluster stats", &cluster_stats_},
+    {"particle cloud publish", &cloud_stats_},
+    {"pose publish", &pose_stats_}};
+  for (const auto & phase : phases) {
+    const nav2_util::LatencyStats & stats = *phase.second;
+    char text[128];
+    snprintf(text, sizeof(text), "p50 %.3f p90 %.3f p99 %.3f max %.3f (%zu samples)",
+      1e3 * stats.percentile(50), 1e3 * stats.percentile(90), 1e3 * stats.percentile(99),
+      1e3 * stats.max(), stats.count());
+    add_value(std::string(phase.first) + " [ms]", text);
+  }
+
+  int particle_count = pf_ != NULL ? pf_->sets[pf_->current_set].sample_count : 0;
+  add_value("particles", std::to_string(particle_count));
+  add_value("effective sample size", std::to_string(effective_sample_size_));
+  add_value("scans received", std::to_string(scans_received_));
+  add_value("scans processed", std::to_string(scans_processed_));
+  add_value("scans skipped (no motion)", std::to_string(scans_skipped_));
+  add_value("scans dropped", std::to_string(scans_dropped_));
+
+  if (pf_ == NULL) {
+    status.level = diagnostic_msgs::msg::DiagnosticStatus::WARN;
+    status.message = "No map received yet";
+  }
+
+  diagnostic_msgs::msg::DiagnosticArray msg;
+  msg.header.stamp = now();
+  msg.status.push_back(status);
+  diagnostics_pub_->publish(msg);
+}
+
+/**
+ * Effective sample size of the current set, 1 / sum(w^2) for the normalized
+ * weights. It drops towards 1 as the weight concentrates on few particles.
+ */
+double
+AmclNode::effectiveSampleSize()
+{
+  pf_sample_set_t * set = pf_->sets + pf_->current_set;
+  double sum = 0.0;
+  double sum_sq = 0.0;
+  for (int i = 0; i < set->sample_count; i++) {
+    sum += set->weight[i];
+    sum_sq += set->weight[i] * set->weight[i];
+  }
+  return sum_sq > 0.0 ? sum * sum / sum_sq : 0.0;
+}
+
 void
 AmclNode::requestMap()
 {
@@ -348,26 +447,32 @@ AmclNode::handleMapMessage(const nav_msgs::msg::OccupancyGrid & msg)
       global_frame_id_.c_str());
   }
 
+  if (update_map_in_place_ && updateMapInPlace(msg)) {
+    return;
+  }
+
+  // Delete the laser objects because they hold pointers to the existing map,
+  // #5202. The last one created is laser_, which is deleted with the rest of
+  // the map dependent memory.
+  for (Laser * laser : lasers_) {
+    if (laser != laser_) {
+      delete laser;
+    }
+  }
   freeMapDependentMemory();
-  // Clear queued laser objects because they hold pointers to the existing
-  // map, #5202.
   lasers_.clear();
   lasers_update_.clear();
+  lasers_pending_.clear();
+  lasers_data_.clear();
   frame_to_laser_.clear();
 
   map_ = convertMap(msg);
 
-#if NEW_UNIFORM_SAMPLING
-  // Index of free space
-  free_space_indices.resize(0);
-  for (int i = 0; i < map_->size_x; i++) {
-    for (int j = 0; j < map_->size_y; j++) {
-      if (map_->cells[MAP_INDEX(map_, i, j)].occ_state == -1) {
-        free_space_indices.push_back(std::make_pair(i, j));
-      }
-    }
+  // Index of free space, used to draw uniform poses
+  if (map_update_free_cells(map_) == 0) {
+    RCLCPP_WARN(get_logger(), "The map has no free cells, uniform poses will be drawn anywhere");
   }
-#endif
+
   // Create the particle filter
   pf_ = pf_alloc(min_particles_, max_particles_,
       alpha_slow_, alpha_fast_,
@@ -375,6 +480,10 @@ AmclNode::handleMapMessage(const nav_msgs::msg::OccupancyGrid & msg)
       reinterpret_cast<void *>(map_));  // (void *)map_);
   pf_->pop_err = pf_err_;
   pf_->pop_z = pf_z_;
+  if (random_seed_ >= 0) {
+    // pf_alloc seeds drand48 from the clock
+    srand48(random_seed_);
+  }
 
   // Initialize the filter
   updatePoseFromServer();
@@ -395,6 +504,7 @@ AmclNode::handleMapMessage(const nav_msgs::msg::OccupancyGrid & msg)
 
   // Laser
   delete laser_;
+  updateCspace();
   createLaserObject();
 
   // In case the initial pose message arrived before the first map,
@@ -402,6 +512,75 @@ AmclNode::handleMapMessage(const nav_msgs::msg::OccupancyGrid & msg)
   applyInitialPose();
 }
 
+/**
+ * Apply a map with the same geometry as the current one to it in place. Only
+ * the cells that changed are written, and the free cell index, the free space
+ * and cspace distances and the likelihood fields of the lasers are refreshed
+ * over the window they affect around the changed cells, so the particle filter
+ * and the sensor objects carry on as they are. Returns false if the geometry
+ * differs, or if so much of the map changed that it is taken for a different
+ * map, and the map has to be rebuilt.
+ */
+bool
+AmclNode::updateMapInPlace(const nav_msgs::msg::OccupancyGrid & msg)
+{
+  if (map_ == NULL || pf_ == NULL ||
+    static_cast<int>(msg.info.width) != map_->size_x ||
+    static_cast<int>(msg.info.height) != map_->size_y ||
+    msg.info.resolution != map_->scale ||
+    msg.info.origin.position.x + (map_->size_x / 2) * map_->scale != map_->origin_x ||
+    msg.info.origin.position.y + (map_->size_y / 2) * map_->scale != map_->origin_y ||
+    msg.data.size() != static_cast<size_t>(map_->size_x) * map_->size_y)
+  {
+    return false;
+  }
+
+  // A map in which more than this fraction of the cells changed is taken for
+  // a different map rather than an edit, and the filter is re-initialized
+  const double max_changed_fraction = 0.25;
+
+  // Bounding box of the cells that changed
+  int min_i = map_->size_x, min_j = map_->size_y, max_i = -1, max_j = -1;
+  size_t changed = 0;
+  for (int j = 0; j < map_->size_y; j++) {
+    for (int i = 0; i < map_->size_x; i++) {
+      int index = MAP_INDEX(map_, i, j);
+      int8_t state = occupancyToState(msg.data[index]);
+      if (state != map_->occ_state[index]) {
+        map_->occ_state[index] = state;
+        min_i = std::min(min_i, i);
+        max_i = std::max(max_i, i);
+        min_j = std::min(min_j, j);
+        max_j = std::max(max_j, j);
+        changed++;
+      }
+    }
+  }
+
+  if (changed > max_changed_fraction * msg.data.size()) {
+    RCLCPP_WARN(get_logger(), "%.0f%% of the map cells changed, treating it as a new map and "
+      "re-initializing the filter", 100.0 * changed / msg.data.size());
+    return false;
+  }
+
+  if (max_i < 0) {
+    RCLCPP_INFO(get_logger(), "The map is unchanged, keeping the current filter");
+    return true;
+  }
+
+  RCLCPP_INFO(get_logger(), "Updating the map in place, %zu cells in [%d, %d] x [%d, %d] changed",
+    changed, min_i, max_i, min_j, max_j);
+
+  if (map_update_free_cells_region(map_, min_i, min_j, max_i, max_j) == 0) {
+    RCLCPP_WARN(get_logger(), "The map has no free cells, uniform poses will be drawn anywhere");
+  }
+  map_update_free_dist_region(map_, min_i, min_j, max_i, max_j);
+  map_update_cspace_region(map_, min_i, min_j, max_i, max_j, sensor_pool_.get());
+
+  Laser::updateMapRegion(map_, min_i, min_j, max_i, max_j);
+  return true;
+}
+
 void
 AmclNode::freeMapDependentMemory()
 {
@@ -432,29 +611,56 @@ AmclNode::convertMap(const nav_msgs::msg::OccupancyGrid & map_msg)
   map_t * map = map_alloc();
   // ROS_ASSERT(map);
 
-  map->size_x = map_msg.info.width;
-  map->size_y = map_msg.info.height;
+  map_alloc_cells(map, map_msg.info.width, map_msg.info.height);
   map->scale = map_msg.info.resolution;
   map->origin_x = map_msg.info.origin.position.x + (map->size_x / 2) * map->scale;
   map->origin_y = map_msg.info.origin.position.y + (map->size_y / 2) * map->scale;
-  // Convert to player format
-  map->cells =
-    reinterpret_cast<map_cell_t *>(malloc(sizeof(map_cell_t) * map->size_x * map->size_y));
 
-  // ROS_ASSERT(map->cells);
+  // Convert to player format
+  // ROS_ASSERT(map->occ_state);
   for (int i = 0; i < map->size_x * map->size_y; i++) {
-    if (map_msg.data[i] == 0) {
-      map->cells[i].occ_state = -1;
-    } else if (map_msg.data[i] == 100) {
-      map->cells[i].occ_state = +1;
-    } else {
-      map->cells[i].occ_state = 0;
-    }
+    map->occ_state[i] = occupancyToState(map_msg.data[i]);
   }
 
   return map;
 }
 
+/**
+ * Compute the cspace distances needed by the likelihood field models on the
+ * sensor pool, going through the on-disk cache when one is configured. The
+ * models skip their own computation when the map already holds the distances
+ * they need.
+ */
+void
+AmclNode::updateCspace()
+{
+  if (map_ == NULL || sensor_model_type_ == "beam" ||
+    map_->max_occ_dist == laser_likelihood_max_dist_)
+  {
+    return;
+  }
+
+  if (cspace_cache_dir_.empty()) {
+    map_update_cspace(map_, laser_likelihood_max_dist_, sensor_pool_.get());
+    return;
+  }
+
+  uint64_t key = map_cspace_key(map_, laser_likelihood_max_dist_);
+  char name[64];
+  snprintf(name, sizeof(name), "cspace_%016llx.bin", static_cast<unsigned long long>(key));
+  std::string path = cspace_cache_dir_ + "/" + name;
+
+  if (map_load_cspace(map_, key, path.c_str()) == 0) {
+    RCLCPP_INFO(get_logger(), "Loaded the cspace distances from %s", path.c_str());
+    return;
+  }
+
+  map_update_cspace(map_, laser_likelihood_max_dist_, sensor_pool_.get());
+  if (map_save_cspace(map_, key, path.c_str()) != 0) {
+    RCLCPP_WARN(get_logger(), "Failed to save the cspace distances to %s", path.c_str());
+  }
+}
+
 bool
 AmclNode::getOdomPose(
   geometry_msgs::msg::PoseStamped & odom_pose,
@@ -491,37 +697,17 @@ AmclNode::uniformPoseGenerator(void * arg)
 {
   map_t * map = reinterpret_cast<map_t *>(arg);
 
-#if NEW_UNIFORM_SAMPLING
-  unsigned int rand_index = drand48() * free_space_indices.size();
-  std::pair<int, int> free_point = free_space_indices[rand_index];
-  pf_vector_t p;
-  p.v[0] = MAP_WXGX(map, free_point.first);
-  p.v[1] = MAP_WYGY(map, free_point.second);
-  p.v[2] = drand48() * 2 * M_PI - M_PI;
-#else
-  double min_x, max_x, min_y, max_y;
-
-  min_x = (map->size_x * map->scale) / 2.0 - map->origin_x;
-  max_x = (map->size_x * map->scale) / 2.0 + map->origin_x;
-  min_y = (map->size_y * map->scale) / 2.0 - map->origin_y;
-  max_y = (map->size_y * map->scale) / 2.0 + map->origin_y;
+  int index;
+  if (map->free_count > 0) {
+    index = map->free_cells[static_cast<int>(drand48() * map->free_count)];
+  } else {
+    index = static_cast<int>(drand48() * map->size_x * map->size_y);
+  }
 
   pf_vector_t p;
-
-  RCLCPP_DEBUG(get_logger(), "Generating new uniform sample");
-  for (;; ) {
-    p.v[0] = min_x + drand48() * (max_x - min_x);
-    p.v[1] = min_y + drand48() * (max_y - min_y);
-    p.v[2] = drand48() * 2 * M_PI - M_PI;
-    // Check that it's a free cell
-    int i, j;
-    i = MAP_GXWX(map, p.v[0]);
-    j = MAP_GYWY(map, p.v[1]);
-    if (MAP_VALID(map, i, j) && (map->cells[MAP_INDEX(map, i, j)].occ_state == -1)) {
-      break;
-    }
-  }
-#endif
+  p.v[0] = MAP_WXGX(map, index % map->size_x);
+  p.v[1] = MAP_WYGY(map, index / map->size_x);
+  p.v[2] = drand48() * 2 * M_PI - M_PI;
   return p;
 }
 
@@ -571,11 +757,14 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
 {
   std::string laser_scan_frame_id = strutils::stripLeadingSlash(laser_scan->header.frame_id);
   last_laser_received_ts_ = now();
+  std::lock_guard<std::recursive_mutex> lr(configuration_mutex_);
+  ++scans_received_;
   if (map_ == NULL) {
+    ++scans_dropped_;
     return;
   }
 
-  std::lock_guard<std::recursive_mutex> lr(configuration_mutex_);
+  nav2_util::ExecutionTimer timer;
   int laser_index = -1;
 
   // Do we have the base->base_laser Tx yet?
@@ -584,6 +773,8 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
       (int)frame_to_laser_.size(), laser_scan_frame_id.c_str());
     lasers_.push_back(createLaserObject());
     lasers_update_.push_back(true);
+    lasers_pending_.push_back(false);
+    lasers_data_.push_back(std::make_unique<LaserData>());
     laser_index = frame_to_laser_.size();
 
     geometry_msgs::msg::PoseStamped ident;
@@ -599,6 +790,7 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
         "even though the message notifier is in use",
         laser_scan->header.frame_id.c_str(),
         base_frame_id_.c_str());
+      ++scans_dropped_;
       return;
     }
 
@@ -625,6 +817,7 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
     laser_scan->header.stamp, base_frame_id_))
   {
     RCLCPP_DEBUG(get_logger(), "Couldn't determine robot's pose associated with laser scan");
+    ++scans_dropped_;
     return;
   }
 
@@ -673,7 +866,10 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
     // printf("pose\n");
     // pf_vector_fprintf(pose, stdout, "%.3f");
 
+    timer.start();
     motionModel_->odometryUpdate(pf_, pose, delta);
+    timer.end();
+    motion_stats_.add(timer.elapsed_time_in_seconds());
 
     // Pose at last filter update
     // this->pf_odom_pose = pose;
@@ -682,9 +878,10 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
   bool resampled = false;
   // If the robot has moved, update the filter
   if (lasers_update_[laser_index]) {
-    LaserData ldata;
+    // The scan buffer of each laser is reused from scan to scan
+    LaserData & ldata = *lasers_data_[laser_index];
     ldata.laser = lasers_[laser_index];
-    ldata.range_count = laser_scan->ranges.size();
+    ldata.resizeRanges(laser_scan->ranges.size());
 
     // To account for lasers that are mounted upside-down, we determine the
     // min, max, and increment angles of the laser in the base frame.
@@ -706,6 +903,7 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
     } catch (tf2::TransformException & e) {
       RCLCPP_WARN(get_logger(), "Unable to transform min/max laser angles into base frame: %s",
         e.what());
+      ++scans_dropped_;
       return;
     }
 
@@ -731,9 +929,6 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
     } else {
       range_min = laser_scan->range_min;
     }
-    // The LaserData destructor will free this memory
-    ldata.ranges = new double[ldata.range_count][2];
-    assert(ldata.ranges);
     for (int i = 0; i < ldata.range_count; i++) {
       // amcl doesn't (yet) have a concept of min range.  So we'll map short
       // readings to max range.
@@ -747,15 +942,42 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
         (i * angle_increment);
     }
 
-    lasers_[laser_index]->sensorUpdate(pf_, reinterpret_cast<LaserData *>(&ldata));
-
     lasers_update_[laser_index] = false;
 
     pf_odom_pose_ = pose;
 
+    // The scan waits for the other lasers if they are fused
+    if (std::none_of(lasers_pending_.begin(), lasers_pending_.end(), [](bool p) {return p;})) {
+      fusion_start_ = tf2_ros::fromMsg(laser_scan->header.stamp);
+    }
+    lasers_pending_[laser_index] = true;
+  } else {
+    ++scans_skipped_;
+  }
+
+  if (lasersReady(tf2_ros::fromMsg(laser_scan->header.stamp))) {
+    std::vector<LaserData *> scans;
+    for (unsigned int i = 0; i < lasers_pending_.size(); i++) {
+      if (lasers_pending_[i]) {
+        scans.push_back(lasers_data_[i].get());
+        lasers_pending_[i] = false;
+      }
+    }
+
+    timer.start();
+    Laser::fusedSensorUpdate(pf_, scans);
+    timer.end();
+    sensor_stats_.add(timer.elapsed_time_in_seconds());
+    scans_processed_ += scans.size();
+    effective_sample_size_ = effectiveSampleSize();
+
     // Resample the particles
     if (!(++resample_count_ % resample_interval_)) {
+      timer.start();
       pf_update_resample(pf_);
+      timer.end();
+      resample_stats_.add(timer.elapsed_time_in_seconds() - pf_->cluster_stats_time);
+      cluster_stats_.add(pf_->cluster_stats_time);
       resampled = true;
     }
 
@@ -763,25 +985,13 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
     RCLCPP_DEBUG(get_logger(), "Num samples: %d\n", set->sample_count);
 
     // Publish the resulting cloud
-    // TODO(?): set maximum rate for publishing
     if (!m_force_update) {
-      geometry_msgs::msg::PoseArray cloud_msg;
-      cloud_msg.header.stamp = this->now();
-      cloud_msg.header.frame_id = global_frame_id_;
-      cloud_msg.poses.resize(set->sample_count);
-      for (int i = 0; i < set->sample_count; i++) {
-        cloud_msg.poses[i].position.x = set->samples[i].pose.v[0];
-        cloud_msg.poses[i].position.y = set->samples[i].pose.v[1];
-        cloud_msg.poses[i].position.z = 0;
-        tf2::Quaternion q;
-        q.setRPY(0, 0, set->samples[i].pose.v[2]);
-        tf2::impl::Converter<false, true>::convert(q, cloud_msg.poses[i].orientation);
-      }
-      particlecloud_pub_->publish(cloud_msg);
+      publishParticleCloud();
     }
   }
 
   if (resampled || force_publication) {
+    timer.start();
     // Read out the current hypotheses
     double max_weight = 0.0;
     int max_weight_hyp = -1;
@@ -881,6 +1091,8 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
         this->tf_->transform(tmp_tf_stamped, odom_to_map, odom_frame_id_);
       } catch (tf2::TransformException) {
         RCLCPP_DEBUG(get_logger(), "Failed to subtract base to odom transform");
+        timer.end();
+        pose_stats_.add(timer.elapsed_time_in_seconds());
         return;
       }
 
@@ -903,6 +1115,8 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
     } else {
       RCLCPP_ERROR(get_logger(), "No pose!");
     }
+    timer.end();
+    pose_stats_.add(timer.elapsed_time_in_seconds());
   } else if (latest_tf_valid_) {
     if (tf_broadcast_ == true) {
       // Nothing changed, so we'll just republish the last transform, to keep
@@ -927,6 +1141,101 @@ AmclNode::laserReceived(sensor_msgs::msg::LaserScan::ConstSharedPtr laser_scan)
   }
 }
 
+/**
+ * Whether the pending scans should weigh the particles now. Without fusion
+ * that is as soon as there is one. Fused scans wait until every laser has sent
+ * one since the robot last moved, or until the fusion window since the first of
+ * them is over, so a laser that stops publishing only delays the others.
+ */
+bool
+AmclNode::lasersReady(const tf2::TimePoint & stamp)
+{
+  if (std::none_of(lasers_pending_.begin(), lasers_pending_.end(), [](bool p) {return p;})) {
+    return false;
+  }
+  if (laser_fusion_window_ <= 0.0 ||
+    std::none_of(lasers_update_.begin(), lasers_update_.end(), [](bool u) {return u;}))
+  {
+    return true;
+  }
+  return tf2::durationToSec(stamp - fusion_start_) >= laser_fusion_window_;
+}
+
+/**
+ * Publish the particles, or a summary of them, on the particlecloud topic. The
+ * cloud is only built when someone subscribes, and at most particlecloud_max_rate
+ * times per second. It holds either the particles, a weighted subsample of at
+ * most particlecloud_max_size of them, or the means of the clusters.
+ */
+void
+AmclNode::publishParticleCloud()
+{
+  if (particlecloud_pub_->get_subscription_count() == 0) {
+    return;
+  }
+  tf2::TimePoint now = tf2_ros::fromMsg(this->now());
+  if (cloud_pub_interval.count() > 0.0 &&
+    now - cloud_last_publish_time_ < tf2::durationFromSec(cloud_pub_interval.count()))
+  {
+    return;
+  }
+  cloud_last_publish_time_ = now;
+
+  nav2_util::ExecutionTimer timer;
+  timer.start();
+
+  geometry_msgs::msg::PoseArray cloud_msg;
+  cloud_msg.header.stamp = tf2_ros::toMsg(now);
+  cloud_msg.header.frame_id = global_frame_id_;
+
+  // The poses are planar, so the quaternion only has a z and a w part
+  auto add_pose = [&cloud_msg](const pf_vector_t & pose) {
+      geometry_msgs::msg::Pose p;
+      p.position.x = pose.v[0];
+      p.position.y = pose.v[1];
+      p.orientation.z = sin(0.5 * pose.v[2]);
+      p.orientation.w = cos(0.5 * pose.v[2]);
+      cloud_msg.poses.push_back(p);
+    };
+
+  pf_sample_set_t * set = pf_->sets + pf_->current_set;
+  if (particlecloud_mode_ == "clusters") {
+    cloud_msg.poses.reserve(set->cluster_count);
+    for (int i = 0; i < set->cluster_count; i++) {
+      double weight;
+      pf_vector_t mean;
+      pf_matrix_t cov;
+      if (pf_get_cluster_stats(pf_, i, &weight, &mean, &cov) && weight > 0.0) {
+        add_pose(mean);
+      }
+    }
+  } else if (particlecloud_max_size_ > 0 && particlecloud_max_size_ < set->sample_count) {
+    // Systematic draw over the cumulative weights, with a fixed offset so the
+    // random numbers of the filter are left alone. A particle drawn several
+    // times is published once.
+    cloud_msg.poses.reserve(particlecloud_max_size_);
+    double step = 1.0 / particlecloud_max_size_;
+    double target = 0.5 * step;
+    double cumulative = 0.0;
+    for (int i = 0; i < set->sample_count && target < 1.0; i++) {
+      cumulative += set->weight[i];
+      if (cumulative > target) {
+        add_pose(pf_sample_pose(set, i));
+        target += step * ceil((cumulative - target) / step);
+      }
+    }
+  } else {
+    cloud_msg.poses.reserve(set->sample_count);
+    for (int i = 0; i < set->sample_count; i++) {
+      add_pose(pf_sample_pose(set, i));
+    }
+  }
+
+  particlecloud_pub_->publish(cloud_msg);
+  timer.end();
+  cloud_stats_.add(timer.elapsed_time_in_seconds());
+}
+
 void
 AmclNode::initialPoseReceived(geometry_msgs::msg::PoseWithCovarianceStamped::SharedPtr msg)
 {
@@ -1041,6 +1350,8 @@ AmclNode::createLaserObject()
     laser_ = new LikelihoodFieldModel(z_hit_, z_rand_, sigma_hit_, laser_likelihood_max_dist_,
         max_beams_, map_);
   }
+  laser_->setWorkerPool(sensor_pool_);
+  laser_->setAdaptiveBeamSelection(adaptive_beam_selection_);
   return laser_;
 }
 
@@ -1057,6 +1368,9 @@ AmclNode::createMotionModel()
     RCLCPP_WARN(get_logger(), "Unknown robot motion model, defaulting to differential model");
     motionModel_ = new DifferentialMotionModel(alpha1_, alpha2_, alpha3_, alpha4_);
   }
+  if (random_seed_ >= 0) {
+    motionModel_->setSeed(random_seed_);
+  }
 }
 
 void
@@ -1092,6 +1406,19 @@ AmclNode::initAmclParams()
   get_parameter_or_set("sigma_hit", sigma_hit_, 0.2);
   get_parameter_or_set("lambda_short", lambda_short_, 0.1);
   get_parameter_or_set("laser_likelihood_max_dist", laser_likelihood_max_dist_, 2.0);
+  get_parameter_or_set("adaptive_beam_selection", adaptive_beam_selection_, false);
+  get_parameter_or_set("laser_fusion_window", laser_fusion_window_, 0.0);
+  get_parameter_or_set("update_map_in_place", update_map_in_place_, true);
+  double particlecloud_max_rate;
+  get_parameter_or_set("particlecloud_max_rate", particlecloud_max_rate, 0.0);
+  cloud_pub_interval = std::chrono::duration<double>(
+    particlecloud_max_rate > 0.0 ? 1.0 / particlecloud_max_rate : 0.0);
+  get_parameter_or_set("particlecloud_max_size", particlecloud_max_size_, 0);
+  get_parameter_or_set("particlecloud_mode", particlecloud_mode_, std::string("particles"));
+  get_parameter_or_set("sensor_threads", sensor_threads_, 0);
+  get_parameter_or_set("cspace_cache_dir", cspace_cache_dir_, std::string(""));
+  get_parameter_or_set("random_seed", random_seed_, -1);
+  get_parameter_or_set("diagnostics_period", diagnostics_period_, 1.0);
   get_parameter_or_set("laser_model_type", sensor_model_type_, std::string("likelihood_field"));
   RCLCPP_INFO(get_logger(), "Sensor model type is: \"%s\"", sensor_model_type_.c_str());
   get_parameter_or_set("robot_model_type", robot_model_type_, std::string("differential"));
@@ -1169,6 +1496,15 @@ AmclNode::reconfigureCB()
   dynamic_param_client_->get_event_param("do_beamskip", do_beamskip_);
   dynamic_param_client_->get_event_param("beam_skip_distance", beam_skip_distance_);
   dynamic_param_client_->get_event_param("beam_skip_threshold", beam_skip_threshold_);
+  dynamic_param_client_->get_event_param("adaptive_beam_selection", adaptive_beam_selection_);
+  dynamic_param_client_->get_event_param("laser_fusion_window", laser_fusion_window_);
+  dynamic_param_client_->get_event_param("update_map_in_place", update_map_in_place_);
+  double particlecloud_max_rate;
+  dynamic_param_client_->get_event_param("particlecloud_max_rate", particlecloud_max_rate);
+  cloud_pub_interval = std::chrono::duration<double>(
+    particlecloud_max_rate > 0.0 ? 1.0 / particlecloud_max_rate : 0.0);
+  dynamic_param_client_->get_event_param("particlecloud_max_size", particlecloud_max_size_);
+  dynamic_param_client_->get_event_param("particlecloud_mode", particlecloud_mode_);
 
   if (pf_ != NULL) {
     pf_free(pf_);
@@ -1177,6 +1513,9 @@ AmclNode::reconfigureCB()
   pf_ = pf_alloc(min_particles_, max_particles_, alpha_slow_, alpha_fast_,
       (pf_init_model_fn_t)AmclNode::uniformPoseGenerator,
       reinterpret_cast<void *>(map_));
+  if (random_seed_ >= 0) {
+    srand48(random_seed_);
+  }
 
   dynamic_param_client_->get_event_param("kld_err", pf_err_);
   dynamic_param_client_->get_event_param("kld_z", pf_z_);
@@ -1200,5 +1539,6 @@ AmclNode::reconfigureCB()
   createMotionModel();
   // Laser
   delete laser_;
+  updateCspace();
   createLaserObject();
 }
@@ -0,0 +1,588 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Offline benchmark of the AMCL filter.
+//
+// A robot is driven along a scripted trajectory through the free space of a map
+// and its scans are rendered by ray casting on the same map_t the filter uses.
+// Every step runs the pf pipeline of AmclNode::laserReceived directly (motion
+// model, sensor model, resampling and cluster statistics), without ROS, and the
+// time spent in each phase and the error of the estimated pose are reported.
+// Given the same seed, two runs process the exact same odometry and scans and
+// produce the same estimates, so the numbers can be compared across changes.
+//
+// The scan can be split between several lasers that cover equal sectors around
+// the robot. Their scans are then either fused into one filter update, or each
+// goes through its own sensor update and resample like separate laser topics.
+
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "geometry_msgs/msg/twist.hpp"
+#include "nav2_util/angleutils.hpp"
+#include "nav2_util/execution_timer.hpp"
+#include "nav2_util/latency_stats.hpp"
+#include "nav2_util/map/map.hpp"
+#include "nav2_util/map_loader/map_loader.hpp"
+#include "nav2_util/motion_model/motion_model.hpp"
+#include "nav2_util/pf/pf.hpp"
+#include "nav2_util/random.hpp"
+#include "nav2_util/sensors/laser/laser.hpp"
+#include "nav2_util/worker_pool.hpp"
+
+using nav2_util::BeamModel;
+using nav2_util::DifferentialMotionModel;
+using nav2_util::ExecutionTimer;
+using nav2_util::Laser;
+using nav2_util::LaserData;
+using nav2_util::LatencyStats;
+using nav2_util::LikelihoodFieldModel;
+using nav2_util::LikelihoodFieldModelProb;
+using nav2_util::MotionModel;
+using nav2_util::OmniMotionModel;
+using nav2_util::WorkerPool;
+using nav2_util::Xoshiro256;
+
+namespace
+{
+
+// Upper bound of --threads, far above any core count this runs on
+const int max_threads = 256;
+
+struct Options
+{
+  std::string image;
+  double resolution = 0.05;
+  double origin_x = 0.0;
+  double origin_y = 0.0;
+  bool negate = false;
+  double occupied_thresh = 0.65;
+  double free_thresh = 0.196;
+
+  std::string laser_model_type = "likelihood_field";
+  std::string robot_model_type = "differential";
+  int min_particles = 500;
+  int max_particles = 2000;
+  int max_beams = 60;
+  bool adaptive_beams = false;
+  unsigned int threads = 1;
+  int lasers = 1;
+  bool fuse = false;
+
+  int scan_beams = 360;
+  double range_max = 12.0;
+  double range_noise = 0.02;
+  double step_size = 0.1;
+  int steps = 500;
+  int64_t seed = 42;
+};
+
+void usage(const char * name)
+{
+  fprintf(stderr,
+    "Usage: %s <map image> [options]\n"
+    "  --resolution <m>        map resolution (%.3f)\n"
+    "  --origin <x> <y>        map origin\n"
+    "  --negate                whiter pixels are occupied\n"
+    "  --laser-model <type>    beam, likelihood_field or likelihood_field_prob\n"
+    "  --robot-model <type>    differential or omnidirectional\n"
+    "  --particles <min> <max> particle count bounds (%d %d)\n"
+    "  --max-beams <n>         beams used by the sensor model (%d)\n"
+    "  --adaptive-beams        pick the most informative beams rather than a fixed stride\n"
+    "  --threads <n>           sensor update worker threads (%u)\n"
+    "  --lasers <n>            split the scan between n lasers (%d)\n"
+    "  --fuse                  weigh the scans of all lasers in a single update\n"
+    "  --scan-beams <n>        beams in each synthetic scan (%d)\n"
+    "  --range-max <m>         laser max range (%.1f)\n"
+    "  --range-noise <m>       stddev of the range noise (%.3f)\n"
+    "  --step <m>              distance travelled between updates (%.2f)\n"
+    "  --steps <n>             number of filter updates (%d)\n"
+    "  --seed <n>              seed of the trajectory, the scans and the filter (%ld)\n",
+    name, Options().resolution, Options().min_particles, Options().max_particles,
+    Options().max_beams, Options().threads, Options().lasers, Options().scan_beams,
+    Options().range_max, Options().range_noise, Options().step_size, Options().steps,
+    static_cast<long>(Options().seed));  // NOLINT
+}
+
+bool parseOptions(int argc, char ** argv, Options & options)
+{
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    // Number of values following the flag
+    auto values = [&](int count) {
+        if (i + count >= argc) {
+          throw std::invalid_argument("missing value for " + arg);
+        }
+        return argv + i + 1;
+      };
+
+    if (arg == "--resolution") {
+      options.resolution = atof(values(1)[0]);
+      i += 1;
+    } else if (arg == "--origin") {
+      options.origin_x = atof(values(2)[0]);
+      options.origin_y = atof(values(2)[1]);
+      i += 2;
+    } else if (arg == "--negate") {
+      options.negate = true;
+    } else if (arg == "--laser-model") {
+      options.laser_model_type = values(1)[0];
+      i += 1;
+    } else if (arg == "--robot-model") {
+      options.robot_model_type = values(1)[0];
+      i += 1;
+    } else if (arg == "--particles") {
+      options.min_particles = atoi(values(2)[0]);
+      options.max_particles = atoi(values(2)[1]);
+      i += 2;
+    } else if (arg == "--max-beams") {
+      options.max_beams = atoi(values(1)[0]);
+      i += 1;
+    } else if (arg == "--adaptive-beams") {
+      options.adaptive_beams = true;
+    } else if (arg == "--threads") {
+      // Parsed signed so that negative counts are rejected instead of wrapping
+      int threads = atoi(values(1)[0]);
+      if (threads < 1 || threads > max_threads) {
+        throw std::invalid_argument(
+          "--threads must be between 1 and " + std::to_string(max_threads));
+      }
+      options.threads = threads;
+      i += 1;
+    } else if (arg == "--lasers") {
+      options.lasers = atoi(values(1)[0]);
+      i += 1;
+    } else if (arg == "--fuse") {
+      options.fuse = true;
+    } else if (arg == "--scan-beams") {
+      options.scan_beams = atoi(values(1)[0]);
+      i += 1;
+    } else if (arg == "--range-max") {
+      options.range_max = atof(values(1)[0]);
+      i += 1;
+    } else if (arg == "--range-noise") {
+      options.range_noise = atof(values(1)[0]);
+      i += 1;
+    } else if (arg == "--step") {
+      options.step_size = atof(values(1)[0]);
+      i += 1;
+    } else if (arg == "--steps") {
+      options.steps = atoi(values(1)[0]);
+      i += 1;
+    } else if (arg == "--seed") {
+      options.seed = atoll(values(1)[0]);
+      i += 1;
+    } else if (arg[0] == '-' || !options.image.empty()) {
+      throw std::invalid_argument("unexpected argument " + arg);
+    } else {
+      options.image = arg;
+    }
+  }
+
+  if (options.image.empty()) {
+    return false;
+  }
+  if (options.min_particles < 1 || options.max_particles < options.min_particles ||
+    options.scan_beams < 2 || options.steps < 1 ||
+    options.lasers < 1 || options.scan_beams / options.lasers < 2)
+  {
+    throw std::invalid_argument("invalid option value");
+  }
+  return true;
+}
+
+// Load the map image and convert it to the pf representation, the same way
+// AmclNode::convertMap does with the map topic
+map_t * loadMap(const Options & options)
+{
+  geometry_msgs::msg::Twist origin;
+  origin.linear.x = options.origin_x;
+  origin.linear.y = options.origin_y;
+
+  nav_msgs::msg::OccupancyGrid grid = map_loader::loadMapFromFile(options.image,
+      options.resolution, options.negate, options.occupied_thresh, options.free_thresh, origin);
+
+  map_t * map = map_alloc();
+  map_alloc_cells(map, grid.info.width, grid.info.height);
+  map->scale = grid.info.resolution;
+  map->origin_x = grid.info.origin.position.x + (map->size_x / 2) * map->scale;
+  map->origin_y = grid.info.origin.position.y + (map->size_y / 2) * map->scale;
+
+  for (int i = 0; i < map->size_x * map->size_y; i++) {
+    if (grid.data[i] == 0) {
+      map->occ_state[i] = -1;
+    } else if (grid.data[i] == 100) {
+      map->occ_state[i] = +1;
+    } else {
+      map->occ_state[i] = 0;
+    }
+  }
+  map_update_free_cells(map);
+
+  return map;
+}
+
+// Draw uniform poses for the filter, like AmclNode::uniformPoseGenerator
+pf_vector_t uniformPoseGenerator(void * arg)
+{
+  map_t * map = reinterpret_cast<map_t *>(arg);
+
+  int index;
+  if (map->free_count > 0) {
+    index = map->free_cells[static_cast<int>(drand48() * map->free_count)];
+  } else {
+    index = static_cast<int>(drand48() * map->size_x * map->size_y);
+  }
+
+  pf_vector_t p;
+  p.v[0] = MAP_WXGX(map, index % map->size_x);
+  p.v[1] = MAP_WYGY(map, index / map->size_x);
+  p.v[2] = drand48() * 2 * M_PI - M_PI;
+  return p;
+}
+
+/**
+ * @class Simulator
+ * @brief Drives a robot through the free space of a map and renders its scans
+ *
+ * The robot moves straight ahead and turns in place whenever an obstacle is
+ * close in front of it. All the randomness (start pose, turn direction and
+ * range noise) comes from a generator of its own, so the trajectory and the
+ * scans only depend on the seed.
+ */
+class Simulator
+{
+public:
+  Simulator(map_t * map, const Options & options)
+  : map_(map), options_(options), rng_(options.seed)
+  {
+    if (map_->free_count == 0) {
+      throw std::runtime_error("the map has no free cells");
+    }
+
+    // Start on a free cell with some room in front of it
+    for (int attempt = 0; attempt < 1000; attempt++) {
+      int index = map_->free_cells[static_cast<int>(rng_.uniform() * map_->free_count)];
+      pose_.v[0] = MAP_WXGX(map_, index % map_->size_x);
+      pose_.v[1] = MAP_WYGY(map_, index / map_->size_x);
+      pose_.v[2] = rng_.uniform() * 2 * M_PI - M_PI;
+      if (clearance(pose_.v[2]) > 4 * options_.step_size) {
+        break;
+      }
+    }
+  }
+
+  // True pose of the robot, which is also its odometry
+  const pf_vector_t & pose() const {return pose_;}
+
+  // Move the robot by one step
+  void step()
+  {
+    const double min_clearance = 2 * options_.step_size + 0.3;
+
+    if (clearance(pose_.v[2]) > min_clearance) {
+      pose_.v[0] += options_.step_size * cos(pose_.v[2]);
+      pose_.v[1] += options_.step_size * sin(pose_.v[2]);
+      return;
+    }
+
+    // Blocked: keep turning the same way until the way ahead is clear
+    if (turn_ == 0.0) {
+      turn_ = rng_.uniform() < 0.5 ? M_PI / 8 : -M_PI / 8;
+    }
+    pose_.v[2] = angleutils::normalize(pose_.v[2] + turn_);
+    if (clearance(pose_.v[2]) > min_clearance) {
+      turn_ = 0.0;
+    }
+  }
+
+  // Render the beams [first, first + count) of a scan from the current pose, with
+  // the laser at the robot origin
+  void scan(LaserData & data, int first, int count)
+  {
+    data.resizeRanges(count);
+    data.range_max = options_.range_max;
+
+    noise_.resize(count);
+    rng_.gaussian(noise_.data(), noise_.size());
+
+    const double increment = 2 * M_PI / options_.scan_beams;
+    for (int i = 0; i < data.range_count; i++) {
+      double bearing = -M_PI + (first + i) * increment;
+      double range = map_calc_range(map_, pose_.v[0], pose_.v[1], pose_.v[2] + bearing,
+          options_.range_max);
+      if (range < options_.range_max) {
+        range = std::min(std::max(range + options_.range_noise * noise_[i], 0.0),
+            options_.range_max);
+      }
+      data.ranges[i][0] = range;
+      data.ranges[i][1] = bearing;
+    }
+  }
+
+private:
+  double clearance(double angle)
+  {
+    return map_calc_range(map_, pose_.v[0], pose_.v[1], angle, options_.range_max);
+  }
+
+  map_t * map_;
+  const Options & options_;
+  Xoshiro256 rng_;
+  pf_vector_t pose_ = pf_vector_zero();
+  double turn_ = 0.0;
+  std::vector<double> noise_;
+};
+
+MotionModel * createMotionModel(const Options & options)
+{
+  if (options.robot_model_type == "omnidirectional") {
+    return new OmniMotionModel(0.2, 0.2, 0.2, 0.2, 0.2);
+  }
+  return new DifferentialMotionModel(0.2, 0.2, 0.2, 0.2);
+}
+
+// Same parameters as the AmclNode defaults
+Laser * createLaserObject(const Options & options, map_t * map)
+{
+  if (options.laser_model_type == "beam") {
+    return new BeamModel(0.5, 0.05, 0.05, 0.5, 0.2, 0.1, 0.0, options.max_beams, map);
+  } else if (options.laser_model_type == "likelihood_field_prob") {
+    return new LikelihoodFieldModelProb(0.5, 0.5, 0.2, 2.0, false, 0.5, 0.3, 0.9,
+             options.max_beams, map);
+  }
+  return new LikelihoodFieldModel(0.5, 0.5, 0.2, 2.0, options.max_beams, map);
+}
+
+// Mean of the most likely cluster, or false if there is none
+bool estimatePose(pf_t * pf, pf_vector_t & estimate)
+{
+  double max_weight = 0.0;
+  for (int i = 0; i < pf->sets[pf->current_set].cluster_count; i++) {
+    double weight;
+    pf_vector_t mean;
+    pf_matrix_t cov;
+    if (pf_get_cluster_stats(pf, i, &weight, &mean, &cov) && weight > max_weight) {
+      max_weight = weight;
+      estimate = mean;
+    }
+  }
+  return max_weight > 0.0;
+}
+
+void printStats(const char * name, const LatencyStats & stats, double total)
+{
+  printf("  %-10s %10.3f %10.3f %10.3f %10.3f\n", name,
+    1e3 * total / std::max<uint64_t>(stats.totalCount(), 1),
+    1e3 * stats.percentile(50), 1e3 * stats.percentile(99), 1e3 * stats.max());
+}
+
+}  // namespace
+
+int
+main(int argc, char ** argv)
+{
+  Options options;
+  try {
+    if (!parseOptions(argc, argv, options)) {
+      usage(argv[0]);
+      return 1;
+    }
+  } catch (std::invalid_argument & e) {
+    fprintf(stderr, "%s\n", e.what());
+    usage(argv[0]);
+    return 1;
+  }
+
+  map_t * map;
+  try {
+    map = loadMap(options);
+  } catch (std::runtime_error & e) {
+    fprintf(stderr, "Couldn't load the map: %s\n", e.what());
+    return 1;
+  }
+  map_update_cspace(map, 2.0);
+
+  Simulator simulator(map, options);
+
+  // The filter starts from a Gaussian around the true pose, like the default
+  // initial pose covariance of AmclNode
+  pf_t * pf = pf_alloc(options.min_particles, options.max_particles, 0.001, 0.1,
+      uniformPoseGenerator, reinterpret_cast<void *>(map));
+  pf->pop_err = 0.05;
+  pf->pop_z = 0.99;
+  // pf_alloc seeds drand48 from the clock
+  srand48(options.seed);
+
+  pf_matrix_t init_cov = pf_matrix_zero();
+  init_cov.m[0][0] = 0.5 * 0.5;
+  init_cov.m[1][1] = 0.5 * 0.5;
+  init_cov.m[2][2] = (M_PI / 12.0) * (M_PI / 12.0);
+  pf_init(pf, simulator.pose(), init_cov);
+
+  std::unique_ptr<MotionModel> motion_model(createMotionModel(options));
+  motion_model->setSeed(options.seed);
+
+  // The lasers share the worker pool, like the lasers of AmclNode
+  std::shared_ptr<WorkerPool> pool;
+  if (options.threads > 1) {
+    pool = std::make_shared<WorkerPool>(options.threads);
+  }
+  std::vector<std::unique_ptr<Laser>> lasers;
+  std::vector<std::unique_ptr<LaserData>> ldata;
+  for (int i = 0; i < options.lasers; i++) {
+    lasers.emplace_back(createLaserObject(options, map));
+    lasers.back()->setWorkerPool(pool);
+    lasers.back()->setAdaptiveBeamSelection(options.adaptive_beams);
+    pf_vector_t laser_pose = pf_vector_zero();
+    lasers.back()->SetLaserPose(laser_pose);
+
+    ldata.emplace_back(new LaserData);
+    ldata.back()->laser = lasers.back().get();
+  }
+
+  LatencyStats motion_stats(options.steps), sensor_stats(options.steps),
+  resample_stats(options.steps), cluster_stats(options.steps), update_stats(options.steps);
+  double motion_total = 0.0, sensor_total = 0.0, resample_total = 0.0, cluster_total = 0.0,
+    update_total = 0.0;
+  double position_error_total = 0.0, angle_error_total = 0.0, position_error_max = 0.0;
+  double position_error = 0.0, angle_error = 0.0;
+  double sample_total = 0.0;
+  int estimates = 0;
+
+  ExecutionTimer timer;
+  pf_vector_t odom_pose = simulator.pose();
+
+  for (int step = 0; step < options.steps; step++) {
+    simulator.step();
+    // Each laser covers an equal sector, the last one takes the leftover beams
+    const int sector = options.scan_beams / options.lasers;
+    for (int i = 0; i < options.lasers; i++) {
+      int count = i + 1 < options.lasers ? sector : options.scan_beams - i * sector;
+      simulator.scan(*ldata[i], i * sector, count);
+    }
+
+    // Change in the odometric pose since the last update
+    pf_vector_t pose = simulator.pose();
+    pf_vector_t delta = pf_vector_zero();
+    delta.v[0] = pose.v[0] - odom_pose.v[0];
+    delta.v[1] = pose.v[1] - odom_pose.v[1];
+    delta.v[2] = angleutils::angle_diff(pose.v[2], odom_pose.v[2]);
+    odom_pose = pose;
+
+    timer.start();
+    motion_model->odometryUpdate(pf, pose, delta);
+    timer.end();
+    double motion_time = timer.elapsed_time_in_seconds();
+
+    double sensor_time = 0.0, resample_time = 0.0, cluster_time = 0.0;
+    if (options.fuse) {
+      std::vector<LaserData *> scans;
+      for (auto & data : ldata) {
+        scans.push_back(data.get());
+      }
+
+      timer.start();
+      Laser::fusedSensorUpdate(pf, scans);
+      timer.end();
+      sensor_time = timer.elapsed_time_in_seconds();
+
+      timer.start();
+      pf_update_resample(pf);
+      timer.end();
+      resample_time = timer.elapsed_time_in_seconds() - pf->cluster_stats_time;
+      cluster_time = pf->cluster_stats_time;
+    } else {
+      for (auto & data : ldata) {
+        timer.start();
+        data->laser->sensorUpdate(pf, data.get());
+        timer.end();
+        sensor_time += timer.elapsed_time_in_seconds();
+
+        timer.start();
+        pf_update_resample(pf);
+        timer.end();
+        resample_time += timer.elapsed_time_in_seconds() - pf->cluster_stats_time;
+        cluster_time += pf->cluster_stats_time;
+      }
+    }
+
+    double update_time = motion_time + sensor_time + resample_time + cluster_time;
+
+    motion_stats.add(motion_time);
+    sensor_stats.add(sensor_time);
+    resample_stats.add(resample_time);
+    cluster_stats.add(cluster_time);
+    update_stats.add(update_time);
+    motion_total += motion_time;
+    sensor_total += sensor_time;
+    resample_total += resample_time;
+    cluster_total += cluster_time;
+    update_total += update_time;
+
+    sample_total += pf->sets[pf->current_set].sample_count;
+
+    pf_vector_t estimate = pf_vector_zero();
+    if (estimatePose(pf, estimate)) {
+      position_error = hypot(estimate.v[0] - pose.v[0], estimate.v[1] - pose.v[1]);
+      angle_error = fabs(angleutils::angle_diff(estimate.v[2], pose.v[2]));
+      position_error_total += position_error;
+      angle_error_total += angle_error;
+      position_error_max = std::max(position_error_max, position_error);
+      estimates++;
+    }
+  }
+
+  printf("Map %s: %d x %d cells, %d free, %.3f m/cell\n", options.image.c_str(),
+    map->size_x, map->size_y, map->free_count, map->scale);
+  printf("%d updates, %s laser model, %s motion model, seed %ld\n", options.steps,
+    options.laser_model_type.c_str(), options.robot_model_type.c_str(),
+    static_cast<long>(options.seed));  // NOLINT
+  if (options.lasers > 1) {
+    printf("%d lasers, %s\n", options.lasers,
+      options.fuse ? "fused updates" : "one update per scan");
+  }
+  printf("\n  %-10s %10s %10s %10s %10s\n", "phase [ms]", "mean", "p50", "p99", "max");
+  printStats("motion", motion_stats, motion_total);
+  printStats("sensor", sensor_stats, sensor_total);
+  printStats("resample", resample_stats, resample_total);
+  printStats("cluster", cluster_stats, cluster_total);
+  printStats("update", update_stats, update_total);
+  printf("\n");
+  printf("  mean particles        %10.1f\n", sample_total / options.steps);
+  printf("  updates per second    %10.1f\n", options.steps / std::max(update_total, 1e-9));
+  if (estimates > 0) {
+    printf("  mean position error   %10.3f m\n", position_error_total / estimates);
+    printf("  max position error    %10.3f m\n", position_error_max);
+    printf("  final position error  %10.3f m\n", position_error);
+    printf("  mean angle error      %10.3f rad\n", angle_error_total / estimates);
+    printf("  final angle error     %10.3f rad\n", angle_error);
+  } else {
+    printf("  no pose estimate\n");
+  }
+
+  lasers.clear();
+  pf_free(pf);
+  map_free(map);
+  return 0;
+}
@@ -150,8 +150,13 @@ Costmap2D & Costmap2D::operator=(const Costmap2D & map)
     return *this;
   }
 
-  // clean up old data
-  deleteMaps();
+  // reuse the existing buffer when the number of cells does not change,
+  // so that repeatedly snapshotting the same costmap does not allocate
+  bool same_size = costmap_ != NULL && size_x_ * size_y_ == map.size_x_ * map.size_y_;
+  if (!same_size) {
+    // clean up old data
+    deleteMaps();
+  }
 
   size_x_ = map.size_x_;
   size_y_ = map.size_y_;
@@ -160,7 +165,9 @@ Costmap2D & Costmap2D::operator=(const Costmap2D & map)
   origin_y_ = map.origin_y_;
 
   // initialize our various maps
-  initMaps(size_x_, size_y_);
+  if (!same_size) {
+    initMaps(size_x_, size_y_);
+  }
 
   // copy the cost map
   memcpy(costmap_, map.costmap_, size_x_ * size_y_ * sizeof(unsigned char));
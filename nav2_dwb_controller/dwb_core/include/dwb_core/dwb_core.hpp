@@ -160,6 +160,17 @@ protected:
     const nav_2d_msgs::msg::Twist2D velocity,
     std::shared_ptr<dwb_msgs::msg::LocalPlanEvaluation> & results);
 
+  /**
+   * @brief Score a trajectory, reusing the batch scores of the critics that provided them
+   *
+   * @param traj Trajectory to check
+   * @param best_score If positive, the threshold for early termination
+   * @param batch_index Index of traj in batch_, or -1 if it is not part of the batch
+   */
+  dwb_msgs::msg::TrajectoryScore scoreTrajectory(
+    const dwb_msgs::msg::Trajectory2D & traj,
+    double best_score, int batch_index);
+
   /**
    * @brief Transforms global plan into same frame as pose, clips far away poses and possibly prunes passed poses
    *
@@ -176,6 +187,18 @@ protected:
   double prune_distance_;
   bool debug_trajectory_details_;
 
+  /**
+   * @brief If true, roll out all twists at once with TrajectoryGenerator::generateTrajectories
+   *
+   * Off by default: only critics that implement scoreTrajectories gain from the batch, and
+   * every trajectory is still converted back to a message for the other critics.
+   */
+  bool batch_trajectories_;
+  TrajectoryBatch batch_;
+  /// @brief Per critic, the scores for batch_ and whether the critic provided them
+  std::vector<std::vector<double>> batch_scores_;
+  std::vector<bool> batch_scored_;
+
   // Plugin handling
   pluginlib::ClassLoader<TrajectoryGenerator> traj_gen_loader_;
   TrajectoryGenerator::Ptr traj_generator_;
@@ -200,7 +223,17 @@ protected:
 
   std::vector<std::string> default_critic_namespaces_;
 
+  /**
+   * @brief Copy the current local costmap into costmap_view_
+   *
+   * The costmap's mutex is only held for the duration of the copy, so that the critics
+   * can score against a consistent grid without contending with the costmap update thread.
+   */
+  void updateCostmapView();
+
   CostmapROSPtr costmap_ros_;
+  /// @brief Snapshot of the local costmap, taken once per cycle and shared by all critics
+  nav2_costmap_2d::Costmap2D costmap_view_;
   TFBufferPtr tf_;
   DWBPublisher pub_;
   std::shared_ptr<rclcpp::Node> nh_;
@@ -83,8 +83,15 @@ public:
   void publishLocalPlan(
     const std_msgs::msg::Header & header,
     const dwb_msgs::msg::Trajectory2D & traj);
+  /**
+   * @brief Publish the grid scores of the critics
+   *
+   * The grid is laid out from the given costmap, which must be the snapshot the
+   * critics scored against, so the points and every channel have the same size.
+   */
   void publishCostGrid(
     const CostmapROSPtr costmap_ros,
+    const nav2_costmap_2d::Costmap2D * costmap,
     const std::vector<TrajectoryCritic::Ptr> critics);
   void publishGlobalPlan(const nav_2d_msgs::msg::Path2D plan);
   void publishTransformedPlan(const nav_2d_msgs::msg::Path2D plan);
@@ -0,0 +1,98 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DWB_CORE__TRAJECTORY_BATCH_HPP_
+#define DWB_CORE__TRAJECTORY_BATCH_HPP_
+
+#include <vector>
+#include "builtin_interfaces/msg/duration.hpp"
+#include "geometry_msgs/msg/pose2_d.hpp"
+#include "nav_2d_msgs/msg/twist2_d.hpp"
+#include "dwb_msgs/msg/trajectory2_d.hpp"
+
+namespace dwb_core
+{
+
+/**
+ * @class TrajectoryBatch
+ * @brief Structure-of-arrays storage for the trajectories of a whole set of twists
+ *
+ * The poses are stored step-major: the pose of trajectory i at step k lives at
+ * index(i, k) = k * size() + i in the x, y and theta arrays. A loop over all the
+ * trajectories at a fixed step therefore streams through contiguous memory, which
+ * lets generators and critics process many twists per vector instruction.
+ *
+ * Trajectories may have different lengths. Only the first lengths[i] poses of
+ * trajectory i are meaningful; the remaining slots up to num_steps are padding.
+ */
+struct TrajectoryBatch
+{
+  TrajectoryBatch()
+  : num_steps(0) {}
+
+  /// @brief The command velocity of each trajectory
+  std::vector<nav_2d_msgs::msg::Twist2D> twists;
+  /// @brief The number of valid poses of each trajectory
+  std::vector<unsigned int> lengths;
+  /// @brief The number of steps allocated per trajectory, i.e. the maximum length
+  unsigned int num_steps;
+  /// @brief Time difference between first and last poses (shared by all trajectories)
+  builtin_interfaces::msg::Duration duration;
+
+  std::vector<double> x, y, theta;
+
+  size_t size() const {return twists.size();}
+
+  size_t index(size_t traj, unsigned int step) const
+  {
+    return static_cast<size_t>(step) * twists.size() + traj;
+  }
+
+  /**
+   * @brief Resize the pose buffers for the current twists and the given number of steps
+   *
+   * The buffers are only ever grown, so reusing a batch from cycle to cycle does not allocate.
+   */
+  void resize(unsigned int steps)
+  {
+    num_steps = steps;
+    lengths.resize(twists.size());
+    size_t n = static_cast<size_t>(steps) * twists.size();
+    x.resize(n);
+    y.resize(n);
+    theta.resize(n);
+  }
+
+  /**
+   * @brief Convert a single trajectory of the batch back into a Trajectory2D message
+   */
+  dwb_msgs::msg::Trajectory2D getTrajectory(size_t i) const
+  {
+    dwb_msgs::msg::Trajectory2D traj;
+    traj.velocity = twists[i];
+    traj.duration = duration;
+    traj.poses.resize(lengths[i]);
+    for (unsigned int k = 0; k < lengths[i]; ++k) {
+      size_t j = index(i, k);
+      traj.poses[k].x = x[j];
+      traj.poses[k].y = y[j];
+      traj.poses[k].theta = theta[j];
+    }
+    return traj;
+  }
+};
+
+}  // namespace dwb_core
+
+#endif  // DWB_CORE__TRAJECTORY_BATCH_HPP_
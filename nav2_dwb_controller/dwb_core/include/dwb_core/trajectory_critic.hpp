@@ -40,6 +40,7 @@
 #include <memory>
 #include "rclcpp/rclcpp.hpp"
 #include "dwb_core/common_types.hpp"
+#include "dwb_core/trajectory_batch.hpp"
 #include "geometry_msgs/msg/pose2_d.hpp"
 #include "nav_2d_msgs/msg/twist2_d.hpp"
 #include "nav_2d_msgs/msg/path2_d.hpp"
@@ -64,6 +65,8 @@ namespace dwb_core
  *       and there may be some shared work that can be done beforehand to optimize
  *       the scoring of each individual trajectory.
  *  3) scoreTrajectory is called once per trajectory and returns the score.
+ *       When the planner rolls out all twists as a TrajectoryBatch, scoreTrajectories
+ *       is offered the whole batch first; critics that accept it are not called per trajectory.
  *  4) debrief is called after each set of trajectories with the chosen trajectory.
  *       This can be used for stateful critics that monitor the trajectory through time.
  *
@@ -88,14 +91,18 @@ public:
    * @param name The name of this critic
    * @param parent_namespace The namespace of the planner
    * @param costmap_ros Pointer to the costmap
+   * @param costmap The grid to score against. DWBLocalPlanner passes a per-cycle snapshot of
+   *                the costmap here; if null, the live costmap of costmap_ros is used.
    */
   void initialize(
     const std::shared_ptr<rclcpp::Node> & nh,
     std::string & name,
-    CostmapROSPtr costmap_ros)
+    CostmapROSPtr costmap_ros,
+    nav2_costmap_2d::Costmap2D * costmap = nullptr)
   {
     name_ = name;
     costmap_ros_ = costmap_ros;
+    costmap_ = costmap ? costmap : costmap_ros_->getCostmap();
     nh_ = nh;
     nh_->get_parameter_or(name_ + ".scale", scale_, 1.0);
     onInit();
@@ -136,6 +143,22 @@ public:
    */
   virtual double scoreTrajectory(const dwb_msgs::msg::Trajectory2D & traj) = 0;
 
+  /**
+   * @brief Return raw scores for all the trajectories in a batch at once.
+   *
+   * Critics that can score the structure-of-arrays batch directly should override this,
+   * fill scores with one raw score per trajectory and return true. Unlike scoreTrajectory,
+   * illegal trajectories are reported with a negative score instead of an exception.
+   *
+   * @param batch The trajectories to score
+   * @param scores Output param, resized to batch.size()
+   * @return False if batch scoring is not supported, in which case scoreTrajectory is used
+   */
+  virtual bool scoreTrajectories(const TrajectoryBatch &, std::vector<double> &)
+  {
+    return false;
+  }
+
   /**
    * @brief debrief informs the critic what the chosen cmd_vel was (if it cares)
    */
@@ -170,6 +193,8 @@ public:
 protected:
   std::string name_;
   CostmapROSPtr costmap_ros_;
+  /// @brief The grid to read costs from, constant for the duration of a planning cycle
+  nav2_costmap_2d::Costmap2D * costmap_;
   double scale_;
   std::shared_ptr<rclcpp::Node> nh_;
 };
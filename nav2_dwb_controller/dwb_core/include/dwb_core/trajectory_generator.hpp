@@ -35,11 +35,13 @@
 #ifndef DWB_CORE__TRAJECTORY_GENERATOR_HPP_
 #define DWB_CORE__TRAJECTORY_GENERATOR_HPP_
 
+#include <algorithm>
 #include <vector>
 #include <memory>
 #include "rclcpp/rclcpp.hpp"
 #include "nav_2d_msgs/msg/twist2_d.hpp"
 #include "dwb_msgs/msg/trajectory2_d.hpp"
+#include "dwb_core/trajectory_batch.hpp"
 
 namespace dwb_core
 {
@@ -119,6 +121,46 @@ public:
     const geometry_msgs::msg::Pose2D & start_pose,
     const nav_2d_msgs::msg::Twist2D & start_vel,
     const nav_2d_msgs::msg::Twist2D & cmd_vel) = 0;
+
+  /**
+   * @brief Generate the trajectories for a whole set of cmd_vels at once
+   *
+   * The results are written into the structure-of-arrays buffers of the batch, which
+   * are reused from call to call. The default implementation calls generateTrajectory
+   * once per twist. Generators that can roll out many twists in lockstep should override it.
+   *
+   * @param start_pose Current robot location
+   * @param start_vel Current robot velocity
+   * @param twists The desired command velocities
+   * @param batch Output param, filled in with one trajectory per twist
+   */
+  virtual void generateTrajectories(
+    const geometry_msgs::msg::Pose2D & start_pose,
+    const nav_2d_msgs::msg::Twist2D & start_vel,
+    const std::vector<nav_2d_msgs::msg::Twist2D> & twists,
+    TrajectoryBatch & batch)
+  {
+    std::vector<dwb_msgs::msg::Trajectory2D> trajs;
+    trajs.reserve(twists.size());
+    unsigned int num_steps = 0;
+    for (const auto & twist : twists) {
+      trajs.push_back(generateTrajectory(start_pose, start_vel, twist));
+      num_steps = std::max(num_steps, static_cast<unsigned int>(trajs.back().poses.size()));
+    }
+
+    batch.twists = twists;
+    batch.resize(num_steps);
+    for (size_t i = 0; i < trajs.size(); ++i) {
+      batch.duration = trajs[i].duration;
+      batch.lengths[i] = trajs[i].poses.size();
+      for (unsigned int k = 0; k < batch.lengths[i]; ++k) {
+        size_t j = batch.index(i, k);
+        batch.x[j] = trajs[i].poses[k].x;
+        batch.y[j] = trajs[i].poses[k].y;
+        batch.theta[j] = trajs[i].poses[k].theta;
+      }
+    }
+  }
 };
 
 }  // namespace dwb_core
@@ -36,6 +36,7 @@
 #include <vector>
 #include <algorithm>
 #include <memory>
+#include <mutex>
 #include <utility>
 #include "dwb_core/dwb_core.hpp"
 #include "dwb_core/illegal_trajectory_tracker.hpp"
@@ -96,6 +97,7 @@ void DWBLocalPlanner::initialize(
   nh_->get_parameter_or("prune_plan", prune_plan_, true);
   nh_->get_parameter_or("prune_distance", prune_distance_, 1.0);
   nh_->get_parameter_or("debug_trajectory_details", debug_trajectory_details_, false);
+  nh_->get_parameter_or("batch_trajectories", batch_trajectories_, false);
   pub_.initialize(nh_);
 
   // Plugins
@@ -111,6 +113,7 @@ void DWBLocalPlanner::initialize(
   goal_checker_ = std::move(goal_checker_loader_.createUniqueInstance(goal_checker_name));
   goal_checker_->initialize(nh_);
 
+  updateCostmapView();
   loadCritics();
 }
 
@@ -154,10 +157,17 @@ void DWBLocalPlanner::loadCritics()
     RCLCPP_INFO(nh_->get_logger(),
       "Using critic \"%s\" (%s)", plugin_name.c_str(), plugin_class.c_str());
     critics_.push_back(plugin);
-    plugin->initialize(nh_, plugin_name, costmap_ros_);
+    plugin->initialize(nh_, plugin_name, costmap_ros_, &costmap_view_);
   }
 }
 
+void DWBLocalPlanner::updateCostmapView()
+{
+  nav2_costmap_2d::Costmap2D * costmap = costmap_ros_->getCostmap();
+  std::unique_lock<nav2_costmap_2d::Costmap2D::mutex_t> lock(*(costmap->getMutex()));
+  costmap_view_ = *costmap;
+}
+
 bool DWBLocalPlanner::isGoalReached(
   const nav_2d_msgs::msg::Pose2DStamped & pose,
   const nav_2d_msgs::msg::Twist2D & velocity)
@@ -230,6 +240,8 @@ nav_2d_msgs::msg::Twist2DStamped DWBLocalPlanner::computeVelocityCommands(
     results->header.stamp = nh_->now();
   }
 
+  updateCostmapView();
+
   nav_2d_msgs::msg::Path2D transformed_plan = transformGlobalPlan(pose);
   nav_2d_msgs::msg::Pose2DStamped goal_pose;
 
@@ -255,7 +267,7 @@ nav_2d_msgs::msg::Twist2DStamped DWBLocalPlanner::computeVelocityCommands(
     }
 
     pub_.publishLocalPlan(pose.header, best.traj);
-    pub_.publishCostGrid(costmap_ros_, critics_);
+    pub_.publishCostGrid(costmap_ros_, &costmap_view_, critics_);
 
     return cmd_vel;
   } catch (const nav_core2::NoLegalTrajectoriesException & e) {
@@ -266,7 +278,7 @@ nav_2d_msgs::msg::Twist2DStamped DWBLocalPlanner::computeVelocityCommands(
       critic->debrief(empty_cmd);
     }
     pub_.publishLocalPlan(pose.header, empty_traj);
-    pub_.publishCostGrid(costmap_ros_, critics_);
+    pub_.publishCostGrid(costmap_ros_, &costmap_view_, critics_);
 
     throw;
   }
@@ -277,20 +289,14 @@ dwb_msgs::msg::TrajectoryScore DWBLocalPlanner::coreScoringAlgorithm(
   const nav_2d_msgs::msg::Twist2D velocity,
   std::shared_ptr<dwb_msgs::msg::LocalPlanEvaluation> & results)
 {
-  nav_2d_msgs::msg::Twist2D twist;
-  dwb_msgs::msg::Trajectory2D traj;
   dwb_msgs::msg::TrajectoryScore best, worst;
   best.total = -1;
   worst.total = -1;
   IllegalTrajectoryTracker tracker;
 
-  traj_generator_->startNewIteration(velocity);
-  while (traj_generator_->hasMoreTwists()) {
-    twist = traj_generator_->nextTwist();
-    traj = traj_generator_->generateTrajectory(pose, velocity, twist);
-
+  auto evaluate = [&](const dwb_msgs::msg::Trajectory2D & traj, int batch_index) {
     try {
-      dwb_msgs::msg::TrajectoryScore score = scoreTrajectory(traj, best.total);
+      dwb_msgs::msg::TrajectoryScore score = scoreTrajectory(traj, best.total, batch_index);
       tracker.addLegalTrajectory();
       if (results) {
         results->twists.push_back(score);
@@ -321,6 +327,30 @@ dwb_msgs::msg::TrajectoryScore DWBLocalPlanner::coreScoringAlgorithm(
       }
       tracker.addIllegalTrajectory(e);
     }
+  };
+
+  if (batch_trajectories_) {
+    // Roll out every twist in one pass, then let the critics that support it score the
+    // whole batch before falling back to per-trajectory scoring for the rest
+    batch_scores_.resize(critics_.size());
+    batch_scored_.assign(critics_.size(), false);
+    traj_generator_->generateTrajectories(pose, velocity,
+      traj_generator_->getTwists(velocity), batch_);
+    for (unsigned int i = 0; i < critics_.size(); i++) {
+      if (critics_[i]->getScale() != 0.0) {
+        batch_scored_[i] = critics_[i]->scoreTrajectories(batch_, batch_scores_[i]);
+      }
+    }
+
+    for (size_t i = 0; i < batch_.size(); i++) {
+      evaluate(batch_.getTrajectory(i), static_cast<int>(i));
+    }
+  } else {
+    traj_generator_->startNewIteration(velocity);
+    while (traj_generator_->hasMoreTwists()) {
+      nav_2d_msgs::msg::Twist2D twist = traj_generator_->nextTwist();
+      evaluate(traj_generator_->generateTrajectory(pose, velocity, twist), -1);
+    }
   }
 
   if (best.total < 0) {
@@ -341,11 +371,19 @@ dwb_msgs::msg::TrajectoryScore DWBLocalPlanner::coreScoringAlgorithm(
 dwb_msgs::msg::TrajectoryScore DWBLocalPlanner::scoreTrajectory(
   const dwb_msgs::msg::Trajectory2D & traj,
   double best_score)
+{
+  return scoreTrajectory(traj, best_score, -1);
+}
+
+dwb_msgs::msg::TrajectoryScore DWBLocalPlanner::scoreTrajectory(
+  const dwb_msgs::msg::Trajectory2D & traj,
+  double best_score, int batch_index)
 {
   dwb_msgs::msg::TrajectoryScore score;
   score.traj = traj;
 
-  for (TrajectoryCritic::Ptr critic : critics_) {
+  for (unsigned int i = 0; i < critics_.size(); i++) {
+    TrajectoryCritic::Ptr critic = critics_[i];
     dwb_msgs::msg::CriticScore cs;
     cs.name = critic->getName();
     cs.scale = critic->getScale();
@@ -355,7 +393,16 @@ dwb_msgs::msg::TrajectoryScore DWBLocalPlanner::scoreTrajectory(
       continue;
     }
 
-    double critic_score = critic->scoreTrajectory(traj);
+    double critic_score;
+    if (batch_index >= 0 && batch_scored_[i]) {
+      critic_score = batch_scores_[i][batch_index];
+      if (critic_score < 0.0) {
+        throw nav_core2::IllegalTrajectoryException(cs.name,
+                "Trajectory Rejected By Batch Scoring.");
+      }
+    } else {
+      critic_score = critic->scoreTrajectory(traj);
+    }
     cs.raw_score = critic_score;
     score.scores.push_back(cs);
     score.total += critic_score * cs.scale;
@@ -395,9 +442,9 @@ nav_2d_msgs::msg::Path2D DWBLocalPlanner::transformGlobalPlan(
   transformed_plan.header.stamp = pose.header.stamp;
 
   // we'll discard points on the plan that are outside the local costmap
-  nav2_costmap_2d::Costmap2D * costmap = costmap_ros_->getCostmap();
-  double dist_threshold = std::max(costmap->getSizeInCellsX(), costmap->getSizeInCellsY()) *
-    costmap->getResolution() / 2.0;
+  double dist_threshold =
+    std::max(costmap_view_.getSizeInCellsX(), costmap_view_.getSizeInCellsY()) *
+    costmap_view_.getResolution() / 2.0;
   double sq_dist_threshold = dist_threshold * dist_threshold;
   nav_2d_msgs::msg::Pose2DStamped stamped_pose;
   stamped_pose.header.frame_id = global_plan_.header.frame_id;
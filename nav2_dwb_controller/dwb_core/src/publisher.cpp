@@ -165,6 +165,7 @@ void DWBPublisher::publishLocalPlan(
 
 void DWBPublisher::publishCostGrid(
   const CostmapROSPtr costmap_ros,
+  const nav2_costmap_2d::Costmap2D * costmap,
   const std::vector<TrajectoryCritic::Ptr> critics)
 {
   if (!publish_cost_grid_pc_) {return;}
@@ -173,7 +174,6 @@ void DWBPublisher::publishCostGrid(
   cost_grid_pc.header.frame_id = costmap_ros->getGlobalFrameID();
   cost_grid_pc.header.stamp = nh_->now();
 
-  nav2_costmap_2d::Costmap2D * costmap = costmap_ros->getCostmap();
   double x_coord, y_coord;
   unsigned int size_x = costmap->getSizeInCellsX();
   unsigned int size_y = costmap->getSizeInCellsY();
@@ -71,7 +71,6 @@ public:
   virtual bool isValidCost(const unsigned char cost);
 
 protected:
-  nav2_costmap_2d::Costmap2D * costmap_;
   bool sum_scores_;
 };
 }  // namespace dwb_critics
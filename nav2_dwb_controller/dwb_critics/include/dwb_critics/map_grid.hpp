@@ -126,7 +126,6 @@ protected:
   void propogateManhattanDistances();
 
   std::shared_ptr<MapGridQueue> queue_;
-  nav2_costmap_2d::Costmap2D * costmap_;
   std::vector<double> cell_values_;
   double obstacle_score_, unreachable_score_;  ///< Special cell_values
   bool stop_on_failure_;
@@ -36,6 +36,7 @@
 #define DWB_CRITICS__PREFER_FORWARD_HPP_
 
 #include <string>
+#include <vector>
 #include "dwb_core/trajectory_critic.hpp"
 
 namespace dwb_critics
@@ -57,8 +58,13 @@ public:
   : penalty_(1.0), strafe_x_(0.1), strafe_theta_(0.2), theta_scale_(10.0) {}
   void onInit() override;
   double scoreTrajectory(const dwb_msgs::msg::Trajectory2D & traj) override;
+  bool scoreTrajectories(
+    const dwb_core::TrajectoryBatch & batch,
+    std::vector<double> & scores) override;
 
 private:
+  double scoreTwist(const nav_2d_msgs::msg::Twist2D & twist);
+
   double penalty_, strafe_x_, strafe_theta_, theta_scale_;
 };
 
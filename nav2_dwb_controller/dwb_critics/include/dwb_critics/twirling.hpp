@@ -35,6 +35,7 @@
 #ifndef DWB_CRITICS__TWIRLING_HPP_
 #define DWB_CRITICS__TWIRLING_HPP_
 
+#include <vector>
 #include "dwb_core/trajectory_critic.hpp"
 
 namespace dwb_critics
@@ -53,6 +54,9 @@ class TwirlingCritic : public dwb_core::TrajectoryCritic
 public:
   void onInit() override;
   double scoreTrajectory(const dwb_msgs::msg::Trajectory2D & traj) override;
+  bool scoreTrajectories(
+    const dwb_core::TrajectoryBatch & batch,
+    std::vector<double> & scores) override;
 };
 }  // namespace dwb_critics
 
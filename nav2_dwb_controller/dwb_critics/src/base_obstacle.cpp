@@ -44,7 +44,6 @@ namespace dwb_critics
 
 void BaseObstacleCritic::onInit()
 {
-  costmap_ = costmap_ros_->getCostmap();
   nh_->get_parameter_or(name_ + ".sum_scores", sum_scores_, false);
 }
 
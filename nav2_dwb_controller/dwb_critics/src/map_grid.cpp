@@ -63,7 +63,6 @@ bool MapGridCritic::MapGridQueue::validCellToQueue(const costmap_queue::CellData
 
 void MapGridCritic::onInit()
 {
-  costmap_ = costmap_ros_->getCostmap();
   queue_ = std::make_shared<MapGridQueue>(*costmap_, *this);
 
   // Always set to true, but can be overriden by subclasses
@@ -163,9 +162,8 @@ void MapGridCritic::addGridScores(sensor_msgs::msg::PointCloud & pc)
   sensor_msgs::msg::ChannelFloat32 grid_scores;
   grid_scores.name = name_;
 
-  nav2_costmap_2d::Costmap2D * costmap = costmap_ros_->getCostmap();
-  unsigned int size_x = costmap->getSizeInCellsX();
-  unsigned int size_y = costmap->getSizeInCellsY();
+  unsigned int size_x = costmap_->getSizeInCellsX();
+  unsigned int size_y = costmap_->getSizeInCellsY();
   grid_scores.values.resize(size_x * size_y);
   unsigned int i = 0;
   for (unsigned int cy = 0; cy < size_y; cy++) {
@@ -50,18 +50,34 @@ void PreferForwardCritic::onInit()
 }
 
 double PreferForwardCritic::scoreTrajectory(const dwb_msgs::msg::Trajectory2D & traj)
+{
+  return scoreTwist(traj.velocity);
+}
+
+bool PreferForwardCritic::scoreTrajectories(
+  const dwb_core::TrajectoryBatch & batch,
+  std::vector<double> & scores)
+{
+  scores.resize(batch.size());
+  for (size_t i = 0; i < batch.size(); ++i) {
+    scores[i] = scoreTwist(batch.twists[i]);
+  }
+  return true;
+}
+
+double PreferForwardCritic::scoreTwist(const nav_2d_msgs::msg::Twist2D & twist)
 {
   // backward motions bad on a robot without backward sensors
-  if (traj.velocity.x < 0.0) {
+  if (twist.x < 0.0) {
     return penalty_;
   }
   // strafing motions also bad on such a robot
-  if (traj.velocity.x < strafe_x_ && fabs(traj.velocity.theta) < strafe_theta_) {
+  if (twist.x < strafe_x_ && fabs(twist.theta) < strafe_theta_) {
     return penalty_;
   }
 
   // the more we rotate, the less we progress forward
-  return fabs(traj.velocity.theta) * theta_scale_;
+  return fabs(twist.theta) * theta_scale_;
 }
 
 }  // namespace dwb_critics
@@ -47,6 +47,17 @@ double TwirlingCritic::scoreTrajectory(const dwb_msgs::msg::Trajectory2D & traj)
 {
   return fabs(traj.velocity.theta);  // add cost for making the robot spin
 }
+
+bool TwirlingCritic::scoreTrajectories(
+  const dwb_core::TrajectoryBatch & batch,
+  std::vector<double> & scores)
+{
+  scores.resize(batch.size());
+  for (size_t i = 0; i < batch.size(); ++i) {
+    scores[i] = fabs(batch.twists[i].theta);
+  }
+  return true;
+}
 }  // namespace dwb_critics
 
 PLUGINLIB_EXPORT_CLASS(dwb_critics::TwirlingCritic, dwb_core::TrajectoryCritic)
@@ -35,6 +35,7 @@
 #ifndef DWB_PLUGINS__KINEMATIC_PARAMETERS_HPP_
 #define DWB_PLUGINS__KINEMATIC_PARAMETERS_HPP_
 
+#include <cmath>
 #include <memory>
 #include "rclcpp/rclcpp.hpp"
 #include "nav2_dynamic_params/dynamic_params_client.hpp"
@@ -88,6 +89,18 @@ public:
    */
   bool isValidSpeed(double x, double y, double theta);
 
+  /**
+   * @brief Same as isValidSpeed, for a precomputed squared magnitude x * x + y * y
+   */
+  inline bool isValidSpeedSq(double vmag_sq, double theta)
+  {
+    if (max_speed_xy_ >= 0.0 && vmag_sq > max_speed_xy_sq_) {return false;}
+    if (min_speed_xy_ >= 0.0 && vmag_sq < min_speed_xy_sq_ &&
+      min_speed_theta_ >= 0.0 && std::fabs(theta) < min_speed_theta_) {return false;}
+    if (vmag_sq == 0.0 && theta == 0.0) {return false;}
+    return true;
+  }
+
   typedef std::shared_ptr<KinematicParameters> Ptr;
 
 protected:
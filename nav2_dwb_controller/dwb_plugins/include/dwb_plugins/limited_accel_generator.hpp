@@ -36,6 +36,7 @@
 #define DWB_PLUGINS__LIMITED_ACCEL_GENERATOR_HPP_
 
 #include <memory>
+#include <vector>
 #include "dwb_plugins/standard_traj_generator.hpp"
 
 namespace dwb_plugins
@@ -54,6 +55,11 @@ public:
     const geometry_msgs::msg::Pose2D & start_pose,
     const nav_2d_msgs::msg::Twist2D & start_vel,
     const nav_2d_msgs::msg::Twist2D & cmd_vel) override;
+  void generateTrajectories(
+    const geometry_msgs::msg::Pose2D & start_pose,
+    const nav_2d_msgs::msg::Twist2D & start_vel,
+    const std::vector<nav_2d_msgs::msg::Twist2D> & twists,
+    dwb_core::TrajectoryBatch & batch) override;
 
 protected:
   double acceleration_time_;
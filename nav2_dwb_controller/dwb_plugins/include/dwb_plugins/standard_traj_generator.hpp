@@ -63,6 +63,12 @@ public:
     const nav_2d_msgs::msg::Twist2D & start_vel,
     const nav_2d_msgs::msg::Twist2D & cmd_vel) override;
 
+  void generateTrajectories(
+    const geometry_msgs::msg::Pose2D & start_pose,
+    const nav_2d_msgs::msg::Twist2D & start_vel,
+    const std::vector<nav_2d_msgs::msg::Twist2D> & twists,
+    dwb_core::TrajectoryBatch & batch) override;
+
 protected:
   /**
    * @brief Initialize the VelocityIterator pointer. Put in its own function for easy overriding
@@ -117,6 +123,26 @@ protected:
    */
   std::vector<double> getTimeSteps(const nav_2d_msgs::msg::Twist2D & cmd_vel);
 
+  /**
+   * @brief Compute the number of points in the generated trajectory, i.e. the size of getTimeSteps
+   */
+  unsigned int getNumSteps(const nav_2d_msgs::msg::Twist2D & cmd_vel);
+
+  /**
+   * @brief Roll out all the twists in lockstep, one simulation step at a time
+   *
+   * Each inner loop runs across all the twists over contiguous arrays, so that the
+   * compiler can vectorize it with one twist per SIMD lane.
+   *
+   * @param limit_acceleration If true, the velocity converges towards each cmd_vel from start_vel
+   *                           within the acceleration limits. If false, cmd_vel is used throughout.
+   */
+  void rolloutBatch(
+    const geometry_msgs::msg::Pose2D & start_pose,
+    const nav_2d_msgs::msg::Twist2D & start_vel,
+    const std::vector<nav_2d_msgs::msg::Twist2D> & twists,
+    bool limit_acceleration, dwb_core::TrajectoryBatch & batch);
+
   KinematicParameters::Ptr kinematics_;
   std::shared_ptr<VelocityIterator> velocity_iterator_;
 
@@ -133,6 +159,10 @@ protected:
 
   /// @brief If not discretizing by time, the amount of angular space between points
   double angular_granularity_;
+
+  /// @brief Per-twist working arrays for rolloutBatch, kept to avoid reallocating every cycle
+  std::vector<double> lane_dt_, lane_vx_, lane_vy_, lane_vtheta_;
+  std::vector<double> lane_cmd_x_, lane_cmd_y_, lane_cmd_theta_;
 };
 
 
@@ -36,16 +36,25 @@
 #define DWB_PLUGINS__XY_THETA_ITERATOR_HPP_
 
 #include <memory>
+#include <vector>
 #include "dwb_plugins/velocity_iterator.hpp"
 #include "dwb_plugins/one_d_velocity_iterator.hpp"
 
 namespace dwb_plugins
 {
+/**
+ * @class XYThetaIterator
+ * @brief Iterates over all the valid combinations of x, y and theta velocity samples
+ *
+ * At the start of each iteration, the one dimensional samples are expanded once into a
+ * flat table of valid twists, which the iteration then simply walks through. The tables
+ * are kept between iterations so that steady-state sampling does not allocate.
+ */
 class XYThetaIterator : public VelocityIterator
 {
 public:
   XYThetaIterator()
-  : kinematics_(nullptr), x_it_(nullptr), y_it_(nullptr), th_it_(nullptr) {}
+  : kinematics_(nullptr), index_(0) {}
   void initialize(
     const std::shared_ptr<rclcpp::Node> & nh,
     KinematicParameters::Ptr kinematics) override;
@@ -54,12 +63,17 @@ public:
   nav_2d_msgs::msg::Twist2D nextTwist() override;
 
 protected:
-  virtual bool isValidVelocity();
-  void iterateToValidVelocity();
+  /**
+   * @brief Store all the velocities returned by a OneDVelocityIterator, in order
+   */
+  static void fillSamples(OneDVelocityIterator it, std::vector<double> & samples);
+
   int vx_samples_, vy_samples_, vtheta_samples_;
   KinematicParameters::Ptr kinematics_;
 
-  std::shared_ptr<OneDVelocityIterator> x_it_, y_it_, th_it_;
+  std::vector<double> x_samples_, y_samples_, theta_samples_;
+  std::vector<nav_2d_msgs::msg::Twist2D> twists_;
+  size_t index_;
 };
 }  // namespace dwb_plugins
 
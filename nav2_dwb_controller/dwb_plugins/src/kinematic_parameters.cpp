@@ -130,12 +130,7 @@ void KinematicParameters::reconfigureCB()
 
 bool KinematicParameters::isValidSpeed(double x, double y, double theta)
 {
-  double vmag_sq = x * x + y * y;
-  if (max_speed_xy_ >= 0.0 && vmag_sq > max_speed_xy_sq_) {return false;}
-  if (min_speed_xy_ >= 0.0 && vmag_sq < min_speed_xy_sq_ &&
-    min_speed_theta_ >= 0.0 && fabs(theta) < min_speed_theta_) {return false;}
-  if (vmag_sq == 0.0 && theta == 0.0) {return false;}
-  return true;
+  return isValidSpeedSq(x * x + y * y, theta);
 }
 
 }  // namespace dwb_plugins
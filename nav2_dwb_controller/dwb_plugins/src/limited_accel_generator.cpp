@@ -98,6 +98,16 @@ dwb_msgs::msg::Trajectory2D LimitedAccelGenerator::generateTrajectory(
   return traj;
 }
 
+void LimitedAccelGenerator::generateTrajectories(
+  const geometry_msgs::msg::Pose2D & start_pose,
+  const nav_2d_msgs::msg::Twist2D & start_vel,
+  const std::vector<nav_2d_msgs::msg::Twist2D> & twists,
+  dwb_core::TrajectoryBatch & batch)
+{
+  //  like generateTrajectory, each twist is simulated at its constant cmd_vel
+  rolloutBatch(start_pose, start_vel, twists, false, batch);
+}
+
 }  // namespace dwb_plugins
 
 PLUGINLIB_EXPORT_CLASS(dwb_plugins::LimitedAccelGenerator, dwb_core::TrajectoryGenerator)
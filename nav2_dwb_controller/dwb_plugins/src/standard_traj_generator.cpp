@@ -112,9 +112,16 @@ nav_2d_msgs::msg::Twist2D StandardTrajectoryGenerator::nextTwist()
 std::vector<double> StandardTrajectoryGenerator::getTimeSteps(
   const nav_2d_msgs::msg::Twist2D & cmd_vel)
 {
-  std::vector<double> steps;
+  std::vector<double> steps(getNumSteps(cmd_vel));
+  std::fill(steps.begin(), steps.end(), sim_time_ / steps.size());
+  return steps;
+}
+
+unsigned int StandardTrajectoryGenerator::getNumSteps(const nav_2d_msgs::msg::Twist2D & cmd_vel)
+{
+  int num_steps;
   if (discretize_by_time_) {
-    steps.resize(ceil(sim_time_ / time_granularity_));
+    num_steps = ceil(sim_time_ / time_granularity_);
   } else {  // discretize by distance
     double vmag = hypot(cmd_vel.x, cmd_vel.y);
 
@@ -125,15 +132,13 @@ std::vector<double> StandardTrajectoryGenerator::getTimeSteps(
     double projected_angular_distance = fabs(cmd_vel.theta) * sim_time_;
 
     // Pick the maximum of the two
-    int num_steps = ceil(std::max(projected_linear_distance / linear_granularity_,
+    num_steps = ceil(std::max(projected_linear_distance / linear_granularity_,
         projected_angular_distance / angular_granularity_));
-    steps.resize(num_steps);
   }
-  if (steps.size() == 0) {
-    steps.resize(1);
+  if (num_steps <= 0) {
+    num_steps = 1;
   }
-  std::fill(steps.begin(), steps.end(), sim_time_ / steps.size());
-  return steps;
+  return num_steps;
 }
 
 dwb_msgs::msg::Trajectory2D StandardTrajectoryGenerator::generateTrajectory(
@@ -160,6 +165,96 @@ dwb_msgs::msg::Trajectory2D StandardTrajectoryGenerator::generateTrajectory(
   return traj;
 }
 
+void StandardTrajectoryGenerator::generateTrajectories(
+  const geometry_msgs::msg::Pose2D & start_pose,
+  const nav_2d_msgs::msg::Twist2D & start_vel,
+  const std::vector<nav_2d_msgs::msg::Twist2D> & twists,
+  dwb_core::TrajectoryBatch & batch)
+{
+  rolloutBatch(start_pose, start_vel, twists, true, batch);
+}
+
+void StandardTrajectoryGenerator::rolloutBatch(
+  const geometry_msgs::msg::Pose2D & start_pose,
+  const nav_2d_msgs::msg::Twist2D & start_vel,
+  const std::vector<nav_2d_msgs::msg::Twist2D> & twists,
+  bool limit_acceleration, dwb_core::TrajectoryBatch & batch)
+{
+  const size_t n = twists.size();
+  batch.twists = twists;
+  batch.duration = nav2_util::durationFromSeconds(sim_time_);
+  batch.lengths.resize(n);
+
+  lane_dt_.resize(n);
+  lane_vx_.resize(n);
+  lane_vy_.resize(n);
+  lane_vtheta_.resize(n);
+  lane_cmd_x_.resize(n);
+  lane_cmd_y_.resize(n);
+  lane_cmd_theta_.resize(n);
+
+  unsigned int num_steps = 1;
+  for (size_t i = 0; i < n; ++i) {
+    const nav_2d_msgs::msg::Twist2D & cmd_vel = twists[i];
+    batch.lengths[i] = getNumSteps(cmd_vel);
+    num_steps = std::max(num_steps, batch.lengths[i]);
+    lane_dt_[i] = sim_time_ / batch.lengths[i];
+    lane_cmd_x_[i] = cmd_vel.x;
+    lane_cmd_y_[i] = cmd_vel.y;
+    lane_cmd_theta_[i] = cmd_vel.theta;
+    lane_vx_[i] = limit_acceleration ? start_vel.x : cmd_vel.x;
+    lane_vy_[i] = limit_acceleration ? start_vel.y : cmd_vel.y;
+    lane_vtheta_[i] = limit_acceleration ? start_vel.theta : cmd_vel.theta;
+  }
+  batch.resize(num_steps);
+  if (n == 0) {
+    return;
+  }
+
+  std::fill_n(batch.x.begin(), n, start_pose.x);
+  std::fill_n(batch.y.begin(), n, start_pose.y);
+  std::fill_n(batch.theta.begin(), n, start_pose.theta);
+
+  const double acc_x = kinematics_->getAccX(), decel_x = kinematics_->getDecelX();
+  const double acc_y = kinematics_->getAccY(), decel_y = kinematics_->getDecelY();
+  const double acc_theta = kinematics_->getAccTheta();
+  const double decel_theta = kinematics_->getDecelTheta();
+
+  const double * dt = lane_dt_.data();
+  double * vx = lane_vx_.data();
+  double * vy = lane_vy_.data();
+  double * vtheta = lane_vtheta_.data();
+  const double * cmd_x = lane_cmd_x_.data();
+  const double * cmd_y = lane_cmd_y_.data();
+  const double * cmd_theta = lane_cmd_theta_.data();
+
+  // Lanes whose trajectory is shorter than num_steps keep being simulated,
+  // but the extra poses are ignored through batch.lengths
+  for (unsigned int k = 1; k < num_steps; ++k) {
+    const double * x0 = &batch.x[batch.index(0, k - 1)];
+    const double * y0 = &batch.y[batch.index(0, k - 1)];
+    const double * theta0 = &batch.theta[batch.index(0, k - 1)];
+    double * x1 = &batch.x[batch.index(0, k)];
+    double * y1 = &batch.y[batch.index(0, k)];
+    double * theta1 = &batch.theta[batch.index(0, k)];
+
+    if (limit_acceleration) {
+      for (size_t i = 0; i < n; ++i) {
+        vx[i] = projectVelocity(vx[i], acc_x, decel_x, dt[i], cmd_x[i]);
+        vy[i] = projectVelocity(vy[i], acc_y, decel_y, dt[i], cmd_y[i]);
+        vtheta[i] = projectVelocity(vtheta[i], acc_theta, decel_theta, dt[i], cmd_theta[i]);
+      }
+    }
+
+    // Same kinematic model as computeNewPosition
+    for (size_t i = 0; i < n; ++i) {
+      x1[i] = x0[i] + (vx[i] * cos(theta0[i]) + vy[i] * cos(M_PI_2 + theta0[i])) * dt[i];
+      y1[i] = y0[i] + (vx[i] * sin(theta0[i]) + vy[i] * sin(M_PI_2 + theta0[i])) * dt[i];
+      theta1[i] = theta0[i] + vtheta[i] * dt[i];
+    }
+  }
+}
+
 /**
  * change vel using acceleration limits to converge towards sample_target-vel
  */
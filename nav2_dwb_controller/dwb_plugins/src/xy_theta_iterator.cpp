@@ -34,6 +34,7 @@
 
 #include "dwb_plugins/xy_theta_iterator.hpp"
 #include <memory>
+#include <vector>
 #include "nav_2d_utils/parameters.hpp"
 
 namespace dwb_plugins
@@ -53,60 +54,53 @@ void XYThetaIterator::startNewIteration(
   const nav_2d_msgs::msg::Twist2D & current_velocity,
   double dt)
 {
-  x_it_ = std::make_shared<OneDVelocityIterator>(current_velocity.x,
-      kinematics_->getMinX(), kinematics_->getMaxX(),
-      kinematics_->getAccX(), kinematics_->getDecelX(), dt, vx_samples_);
-  y_it_ = std::make_shared<OneDVelocityIterator>(current_velocity.y,
-      kinematics_->getMinY(), kinematics_->getMaxY(),
-      kinematics_->getAccY(), kinematics_->getDecelY(), dt, vy_samples_);
-  th_it_ = std::make_shared<OneDVelocityIterator>(current_velocity.theta,
-      kinematics_->getMinTheta(), kinematics_->getMaxTheta(),
-      kinematics_->getAccTheta(), kinematics_->getDecelTheta(),
-      dt, vtheta_samples_);
-  if (!isValidVelocity()) {
-    iterateToValidVelocity();
+  fillSamples(OneDVelocityIterator(current_velocity.x,
+    kinematics_->getMinX(), kinematics_->getMaxX(),
+    kinematics_->getAccX(), kinematics_->getDecelX(), dt, vx_samples_), x_samples_);
+  fillSamples(OneDVelocityIterator(current_velocity.y,
+    kinematics_->getMinY(), kinematics_->getMaxY(),
+    kinematics_->getAccY(), kinematics_->getDecelY(), dt, vy_samples_), y_samples_);
+  fillSamples(OneDVelocityIterator(current_velocity.theta,
+    kinematics_->getMinTheta(), kinematics_->getMaxTheta(),
+    kinematics_->getAccTheta(), kinematics_->getDecelTheta(),
+    dt, vtheta_samples_), theta_samples_);
+
+  // Expand the valid combinations in x, y, theta order. The linear speed only depends
+  // on x and y, so its square is computed once per pair rather than once per twist.
+  twists_.clear();
+  index_ = 0;
+  nav_2d_msgs::msg::Twist2D twist;
+  for (double x : x_samples_) {
+    twist.x = x;
+    for (double y : y_samples_) {
+      twist.y = y;
+      double vmag_sq = x * x + y * y;
+      for (double theta : theta_samples_) {
+        if (kinematics_->isValidSpeedSq(vmag_sq, theta)) {
+          twist.theta = theta;
+          twists_.push_back(twist);
+        }
+      }
+    }
   }
 }
 
-bool XYThetaIterator::isValidVelocity()
+void XYThetaIterator::fillSamples(OneDVelocityIterator it, std::vector<double> & samples)
 {
-  return kinematics_->isValidSpeed(x_it_->getVelocity(), y_it_->getVelocity(),
-           th_it_->getVelocity());
+  samples.clear();
+  for (; !it.isFinished(); ++it) {
+    samples.push_back(it.getVelocity());
+  }
 }
 
 bool XYThetaIterator::hasMoreTwists()
 {
-  return x_it_ && !x_it_->isFinished();
+  return index_ < twists_.size();
 }
 
-
 nav_2d_msgs::msg::Twist2D XYThetaIterator::nextTwist()
 {
-  nav_2d_msgs::msg::Twist2D velocity;
-  velocity.x = x_it_->getVelocity();
-  velocity.y = y_it_->getVelocity();
-  velocity.theta = th_it_->getVelocity();
-
-  iterateToValidVelocity();
-
-  return velocity;
-}
-
-void XYThetaIterator::iterateToValidVelocity()
-{
-  bool valid = false;
-  while (!valid && hasMoreTwists()) {
-    ++(*th_it_);
-    if (th_it_->isFinished()) {
-      th_it_->reset();
-      ++(*y_it_);
-      if (y_it_->isFinished()) {
-        y_it_->reset();
-        ++(*x_it_);
-      }
-    }
-    valid = isValidVelocity();
-  }
+  return twists_[index_++];
 }
 
 }  // namespace dwb_plugins
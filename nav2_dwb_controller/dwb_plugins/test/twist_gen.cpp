@@ -428,6 +428,45 @@ TEST(TrajectoryGenerator, dwa)
   matchPose(res.poses[4], 1.2, 0, 0);
 }
 
+void matchBatch(
+  dwb_core::TrajectoryGenerator & gen,
+  const nav_2d_msgs::msg::Twist2D & start_vel)
+{
+  std::vector<nav_2d_msgs::msg::Twist2D> twists = gen.getTwists(start_vel);
+  dwb_core::TrajectoryBatch batch;
+  gen.generateTrajectories(origin, start_vel, twists, batch);
+  ASSERT_EQ(batch.size(), twists.size());
+  for (size_t i = 0; i < twists.size(); ++i) {
+    dwb_msgs::msg::Trajectory2D expected = gen.generateTrajectory(origin, start_vel, twists[i]);
+    dwb_msgs::msg::Trajectory2D res = batch.getTrajectory(i);
+    matchTwist(res.velocity, expected.velocity);
+    EXPECT_DOUBLE_EQ(durationToSec(res.duration), durationToSec(expected.duration));
+    ASSERT_EQ(res.poses.size(), expected.poses.size());
+    for (size_t j = 0; j < res.poses.size(); ++j) {
+      matchPose(res.poses[j], expected.poses[j]);
+    }
+  }
+}
+
+TEST(TrajectoryGenerator, batch)
+{
+  auto nh = makeTestNode("batch");
+  StandardTrajectoryGenerator gen;
+  gen.initialize(nh);
+  matchBatch(gen, zero);
+  matchBatch(gen, forward);
+}
+
+TEST(TrajectoryGenerator, dwa_batch)
+{
+  auto nh = makeTestNode("dwa_batch");
+  nh->set_parameters({rclcpp::Parameter("use_dwa", true)});
+  nh->set_parameters({rclcpp::Parameter("discretize_by_time", true)});
+  dwb_plugins::LimitedAccelGenerator gen;
+  gen.initialize(nh);
+  matchBatch(gen, forward);
+}
+
 int main(int argc, char ** argv)
 {
   forward.x = 0.3;
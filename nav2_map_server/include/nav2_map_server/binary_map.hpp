@@ -0,0 +1,44 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_MAP_SERVER__BINARY_MAP_HPP_
+#define NAV2_MAP_SERVER__BINARY_MAP_HPP_
+
+#include <string>
+
+#include "nav_msgs/msg/occupancy_grid.hpp"
+
+namespace nav2_map_server
+{
+
+// A native binary map file holds a fixed header with the dimensions, the
+// resolution and the origin pose of the map, followed by the width * height
+// occupancy values in OccupancyGrid order, in native byte order. It is loaded
+// without decoding or converting anything.
+
+// Check whether a file starts with the binary map signature
+bool isBinaryMapFile(const std::string & filename);
+
+// Map a binary map file into memory and copy it into the message. Throws
+// std::runtime_error if the file can't be read or is malformed.
+void loadBinaryMap(const std::string & filename, nav_msgs::msg::OccupancyGrid & map);
+
+// Write a map to a binary map file. The file is written under a unique
+// temporary name in the same directory and renamed, so readers never see a
+// partial file.
+bool saveBinaryMap(const std::string & filename, const nav_msgs::msg::OccupancyGrid & map);
+
+}  // namespace nav2_map_server
+
+#endif  // NAV2_MAP_SERVER__BINARY_MAP_HPP_
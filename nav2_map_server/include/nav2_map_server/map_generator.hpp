@@ -25,17 +25,25 @@ namespace nav2_map_server
 class MapGenerator : public rclcpp::Node
 {
 public:
-  MapGenerator(const std::string & mapname, int threshold_occupied, int threshold_free);
+  MapGenerator(
+    const std::string & mapname, int threshold_occupied, int threshold_free,
+    bool binary = false);
 
   void mapCallback(const nav_msgs::msg::OccupancyGrid::SharedPtr map);
 
   bool saved_map_;
 
 private:
+  // Write the map as a trinary PGM image, using the thresholds
+  bool savePgm(const std::string & mapdatafile, const nav_msgs::msg::OccupancyGrid & map);
+
   std::string mapname_;
   rclcpp::Subscription<nav_msgs::msg::OccupancyGrid>::ConstSharedPtr map_sub_;
   int threshold_occupied_;
   int threshold_free_;
+
+  // Write the native binary map format instead of a PGM image
+  bool binary_;
 };
 
 }  // namespace nav2_map_server
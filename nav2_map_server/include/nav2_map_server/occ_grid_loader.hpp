@@ -34,13 +34,16 @@ public:
   explicit OccGridLoader(rclcpp::Node * node, YAML::Node & doc);
   OccGridLoader() = delete;
 
-  // Load the image and generate an OccupancyGrid
+  // Load the image or binary map file and generate an OccupancyGrid
   void loadMapFromFile(const std::string & filename) override;
 
   // Make the OccupancyGrid available via ROS topic and service
   void startServices() override;
 
 protected:
+  // Decode an image file and convert its pixels to occupancy values
+  void loadImage(const std::string & filename);
+
   // The ROS node to use for ROS-related operations such as creating a service
   rclcpp::Node * node_;
 
@@ -0,0 +1,169 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_map_server/binary_map.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace nav2_map_server
+{
+
+namespace
+{
+
+// Layout of the start of a binary map file
+struct BinaryMapHeader
+{
+  char magic[8];
+  uint32_t width, height;
+  double resolution;
+  double position[3];
+  double orientation[4];
+};
+
+static_assert(sizeof(BinaryMapHeader) == 80, "The binary map header must not be padded");
+
+const char binary_map_magic[8] = {'N', 'A', 'V', '2', 'M', 'A', 'P', '1'};
+
+}  // namespace
+
+bool isBinaryMapFile(const std::string & filename)
+{
+  char magic[sizeof(binary_map_magic)];
+
+  FILE * file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  bool found = fread(magic, sizeof(magic), 1, file) == 1 &&
+    memcmp(magic, binary_map_magic, sizeof(magic)) == 0;
+  fclose(file);
+  return found;
+}
+
+void loadBinaryMap(const std::string & filename, nav_msgs::msg::OccupancyGrid & map)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("failed to open map file \"" + filename + "\"");
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(BinaryMapHeader)) {
+    close(fd);
+    throw std::runtime_error("map file \"" + filename + "\" is too short");
+  }
+
+  const size_t size = info.st_size;
+  void * data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("failed to map file \"" + filename + "\" into memory");
+  }
+
+  // The data is read front to back exactly once
+  madvise(data, size, MADV_SEQUENTIAL);
+
+  const BinaryMapHeader * header = static_cast<const BinaryMapHeader *>(data);
+  const size_t count = static_cast<size_t>(header->width) * header->height;
+  if (memcmp(header->magic, binary_map_magic, sizeof(binary_map_magic)) != 0 ||
+    size != sizeof(BinaryMapHeader) + count)
+  {
+    munmap(data, size);
+    throw std::runtime_error("map file \"" + filename + "\" is not a valid binary map");
+  }
+
+  map.info.width = header->width;
+  map.info.height = header->height;
+  map.info.resolution = header->resolution;
+  map.info.origin.position.x = header->position[0];
+  map.info.origin.position.y = header->position[1];
+  map.info.origin.position.z = header->position[2];
+  map.info.origin.orientation.x = header->orientation[0];
+  map.info.origin.orientation.y = header->orientation[1];
+  map.info.origin.orientation.z = header->orientation[2];
+  map.info.origin.orientation.w = header->orientation[3];
+
+  const int8_t * cells = reinterpret_cast<const int8_t *>(header + 1);
+  map.data.assign(cells, cells + count);
+
+  munmap(data, size);
+}
+
+bool saveBinaryMap(const std::string & filename, const nav_msgs::msg::OccupancyGrid & map)
+{
+  const size_t count = static_cast<size_t>(map.info.width) * map.info.height;
+  if (map.data.size() != count) {
+    return false;
+  }
+
+  BinaryMapHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, binary_map_magic, sizeof(binary_map_magic));
+  header.width = map.info.width;
+  header.height = map.info.height;
+  header.resolution = map.info.resolution;
+  header.position[0] = map.info.origin.position.x;
+  header.position[1] = map.info.origin.position.y;
+  header.position[2] = map.info.origin.position.z;
+  header.orientation[0] = map.info.origin.orientation.x;
+  header.orientation[1] = map.info.origin.orientation.y;
+  header.orientation[2] = map.info.origin.orientation.z;
+  header.orientation[3] = map.info.origin.orientation.w;
+
+  // A unique temporary name in the same directory, so that concurrent
+  // writers don't write into the same file and the rename stays atomic
+  std::vector<char> tmp_name(filename.begin(), filename.end());
+  const char suffix[] = ".XXXXXX";
+  tmp_name.insert(tmp_name.end(), suffix, suffix + sizeof(suffix));
+
+  int fd = mkstemp(tmp_name.data());
+  if (fd < 0) {
+    return false;
+  }
+  // mkstemp() creates the file readable by the owner only
+  fchmod(fd, 0644);
+
+  FILE * file = fdopen(fd, "wb");
+  if (!file) {
+    close(fd);
+    remove(tmp_name.data());
+    return false;
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+    fwrite(map.data.data(), 1, count, file) == count;
+  ok = (fclose(file) == 0) && ok;
+
+  if (ok) {
+    ok = rename(tmp_name.data(), filename.c_str()) == 0;
+  }
+  if (!ok) {
+    remove(tmp_name.data());
+  }
+  return ok;
+}
+
+}  // namespace nav2_map_server
@@ -38,6 +38,7 @@
 #include "nav_msgs/msg/occupancy_grid.h"
 #include "tf2/LinearMath/Quaternion.h"
 #include "tf2/LinearMath/Matrix3x3.h"
+#include "nav2_map_server/binary_map.hpp"
 
 namespace nav2_map_server
 {
@@ -45,12 +46,14 @@ namespace nav2_map_server
 /**
  * @brief Map generation node.
  */
-MapGenerator::MapGenerator(const std::string & mapname, int threshold_occupied, int threshold_free)
+MapGenerator::MapGenerator(
+  const std::string & mapname, int threshold_occupied, int threshold_free, bool binary)
 : Node("map_saver"),
   saved_map_(false),
   mapname_(mapname),
   threshold_occupied_(threshold_occupied),
-  threshold_free_(threshold_free)
+  threshold_free_(threshold_free),
+  binary_(binary)
 {
   RCLCPP_INFO(get_logger(), "Waiting for the map");
   map_sub_ = create_subscription<nav_msgs::msg::OccupancyGrid>(
@@ -66,31 +69,23 @@ void MapGenerator::mapCallback(const nav_msgs::msg::OccupancyGrid::SharedPtr map
     map->info.resolution);
 
 
-  std::string mapdatafile = mapname_ + ".pgm";
-  RCLCPP_INFO(logger, "Writing map occupancy data to %s", mapdatafile.c_str());
-  FILE * out = fopen(mapdatafile.c_str(), "w");
-  if (!out) {
-    RCLCPP_ERROR(logger, "Couldn't save map file to %s", mapdatafile.c_str());
-    return;
-  }
-
-  fprintf(out, "P5\n# CREATOR: map_saver.cpp %.3f m/pix\n%d %d\n255\n",
-    map->info.resolution, map->info.width, map->info.height);
-  for (unsigned int y = 0; y < map->info.height; y++) {
-    for (unsigned int x = 0; x < map->info.width; x++) {
-      unsigned int i = x + (map->info.height - y - 1) * map->info.width;
-      if (map->data[i] >= 0 && map->data[i] <= threshold_free_) {  // [0,free)
-        fputc(254, out);
-      } else if (map->data[i] >= threshold_occupied_) {  // (occ,255]
-        fputc(000, out);
-      } else {  // occ [0.25,0.65]
-        fputc(205, out);
-      }
+  std::string mapdatafile;
+  if (binary_) {
+    // The binary format keeps the occupancy values as they are, so the
+    // thresholds don't apply
+    mapdatafile = mapname_ + ".bin";
+    RCLCPP_INFO(logger, "Writing map occupancy data to %s", mapdatafile.c_str());
+    if (!saveBinaryMap(mapdatafile, *map)) {
+      RCLCPP_ERROR(logger, "Couldn't save map file to %s", mapdatafile.c_str());
+      return;
+    }
+  } else {
+    mapdatafile = mapname_ + ".pgm";
+    if (!savePgm(mapdatafile, *map)) {
+      return;
     }
   }
 
-  fclose(out);
-
   std::string mapmetadatafile = mapname_ + ".yaml";
   RCLCPP_INFO(logger, "Writing map occupancy data to %s", mapmetadatafile.c_str());
   FILE * yaml = fopen(mapmetadatafile.c_str(), "w");
@@ -114,4 +109,33 @@ void MapGenerator::mapCallback(const nav_msgs::msg::OccupancyGrid::SharedPtr map
   saved_map_ = true;
 }
 
+bool MapGenerator::savePgm(
+  const std::string & mapdatafile, const nav_msgs::msg::OccupancyGrid & map)
+{
+  RCLCPP_INFO(get_logger(), "Writing map occupancy data to %s", mapdatafile.c_str());
+  FILE * out = fopen(mapdatafile.c_str(), "w");
+  if (!out) {
+    RCLCPP_ERROR(get_logger(), "Couldn't save map file to %s", mapdatafile.c_str());
+    return false;
+  }
+
+  fprintf(out, "P5\n# CREATOR: map_saver.cpp %.3f m/pix\n%d %d\n255\n",
+    map.info.resolution, map.info.width, map.info.height);
+  for (unsigned int y = 0; y < map.info.height; y++) {
+    for (unsigned int x = 0; x < map.info.width; x++) {
+      unsigned int i = x + (map.info.height - y - 1) * map.info.width;
+      if (map.data[i] >= 0 && map.data[i] <= threshold_free_) {  // [0,free)
+        fputc(254, out);
+      } else if (map.data[i] >= threshold_occupied_) {  // (occ,255]
+        fputc(000, out);
+      } else {  // occ [0.25,0.65]
+        fputc(205, out);
+      }
+    }
+  }
+
+  fclose(out);
+  return true;
+}
+
 }  // namespace nav2_map_server
@@ -39,7 +39,7 @@
 #define USAGE "Usage: \n" \
   "  map_saver -h\n" \
   "  map_saver [--occ <threshold_occupied>] [--free <threshold_free>] " \
-  "[-f <mapname>] [ROS remapping args]"
+  "[--format <pgm|bin>] [-f <mapname>] [ROS remapping args]"
 
 using namespace std::chrono_literals;
 
@@ -51,6 +51,7 @@ int main(int argc, char ** argv)
   std::string mapname = "map";
   int threshold_occupied = 65;
   int threshold_free = 25;
+  bool binary = false;
 
   for (int i = 1; i < argc; i++) {
     if (!strcmp(argv[i], "-h")) {
@@ -85,6 +86,15 @@ int main(int argc, char ** argv)
         puts(USAGE);
         return 1;
       }
+    } else if (!strcmp(argv[i], "--format")) {
+      if (++i < argc && !strcmp(argv[i], "pgm")) {
+        binary = false;
+      } else if (i < argc && !strcmp(argv[i], "bin")) {
+        binary = true;
+      } else {
+        puts(USAGE);
+        return 1;
+      }
     } else {
       puts(USAGE);
       return 1;
@@ -97,7 +107,7 @@ int main(int argc, char ** argv)
   }
 
   auto map_gen = std::make_shared<nav2_map_server::MapGenerator>(mapname, threshold_occupied,
-      threshold_free);
+      threshold_free, binary);
 
   while (!map_gen->saved_map_ && rclcpp::ok()) {
     rclcpp::spin_some(map_gen);
@@ -41,6 +41,8 @@
 
 #include "LinearMath/btQuaternion.h"
 #include "SDL/SDL_image.h"
+#include "nav2_map_server/binary_map.hpp"
+#include "nav2_util/map_loader/occupancy_conversion.hpp"
 
 using namespace std::chrono_literals;
 
@@ -120,6 +122,26 @@ OccGridLoader::OccGridLoader(rclcpp::Node * node, YAML::Node & doc)
 }
 
 void OccGridLoader::loadMapFromFile(const std::string & map_name)
+{
+  // Binary maps already hold occupancy values and are used as they are
+  if (isBinaryMapFile(map_name)) {
+    loadBinaryMap(map_name, msg_);
+  } else {
+    loadImage(map_name);
+  }
+
+  msg_.info.map_load_time = node_->now();
+  msg_.header.frame_id = frame_id_;
+  msg_.header.stamp = node_->now();
+
+  RCLCPP_DEBUG(node_->get_logger(), "Read map %s: %d X %d map @ %.3lf m/cell",
+    map_name.c_str(),
+    msg_.info.width,
+    msg_.info.height,
+    msg_.info.resolution);
+}
+
+void OccGridLoader::loadImage(const std::string & map_name)
 {
   // Load the image using SDL.  If we get NULL back, the image load failed.
   SDL_Surface * img;
@@ -147,85 +169,14 @@ void OccGridLoader::loadMapFromFile(const std::string & map_name)
   // Allocate space to hold the data
   msg_.data.resize(msg_.info.width * msg_.info.height);
 
-  // Get values that we'll need to iterate through the pixels
-  int rowstride = img->pitch;
-  int n_channels = img->format->BytesPerPixel;
-
-  // NOTE: Trinary mode still overrides here to preserve existing behavior.
-  // Alpha will be averaged in with color channels when using trinary mode.
-  int avg_channels;
-  if (mode_ == TRINARY || !img->format->Amask) {
-    avg_channels = n_channels;
-  } else {
-    avg_channels = n_channels - 1;
-  }
-
-  // Copy pixel data into the map structure
-  unsigned char * pixels = (unsigned char *)(img->pixels);
-  int color_sum;
-  for (unsigned int j = 0; j < msg_.info.height; j++) {
-    for (unsigned int i = 0; i < msg_.info.width; i++) {
-      // Compute mean of RGB for this pixel
-      unsigned char * p = pixels + j * rowstride + i * n_channels;
-      color_sum = 0;
-      for (int k = 0; k < avg_channels; k++) {
-        color_sum += *(p + (k));
-      }
-      double color_avg = color_sum / static_cast<double>(avg_channels);
-
-      int alpha;
-      if (n_channels == 1) {
-        alpha = 1;
-      } else {
-        alpha = *(p + n_channels - 1);
-      }
-
-      if (negate_) {
-        color_avg = 255 - color_avg;
-      }
-
-#define MAP_IDX(sx, i, j) ((sx) * (j) + (i))
-
-      unsigned char value;
-      if (mode_ == RAW) {
-        value = color_avg;
-        msg_.data[MAP_IDX(msg_.info.width, i, msg_.info.height - j - 1)] = value;
-        continue;
-      }
-
-      // If negate is true, we consider blacker pixels free, and whiter
-      // pixels free.  Otherwise, it's vice versa.
-      double occ = (255 - color_avg) / 255.0;
-
-      // Apply thresholds to RGB means to determine occupancy values for
-      // map.  Note that we invert the graphics-ordering of the pixels to
-      // produce a map with cell (0,0) in the lower-left corner.
-      if (occ > occupied_thresh_) {
-        value = +100;
-      } else if (occ < free_thresh_) {
-        value = 0;
-      } else if (mode_ == TRINARY || alpha < 1.0) {
-        value = -1;
-      } else {
-        double ratio = (occ - free_thresh_) / (occupied_thresh_ - free_thresh_);
-        value = 99 * ratio;
-      }
-
-      msg_.data[MAP_IDX(msg_.info.width, i, msg_.info.height - j - 1)] = value;
-    }
-  }
+  // Convert the pixels into the map structure
+  const ::MapMode mode = mode_ == RAW ? ::RAW : (mode_ == SCALE ? ::SCALE : ::TRINARY);
+  map_loader::convertImageToOccupancy(
+    static_cast<unsigned char *>(img->pixels), img->w, img->h, img->pitch,
+    img->format->BytesPerPixel, img->format->Amask != 0, negate_ != 0,
+    occupied_thresh_, free_thresh_, mode, msg_.data.data());
 
   SDL_FreeSurface(img);
-
-  msg_.info.map_load_time = node_->now();
-  msg_.header.frame_id = frame_id_;
-  msg_.header.stamp = node_->now();
-
-  RCLCPP_DEBUG(node_->get_logger(), "Read map %s: %d X %d map @ %.3lf m/cell",
-    map_name.c_str(),
-    msg_.info.width,
-    msg_.info.height,
-    msg_.info.resolution);
 }
 
 void OccGridLoader::startServices()
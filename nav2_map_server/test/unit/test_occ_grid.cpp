@@ -36,6 +36,7 @@
 #include <vector>
 #include <memory>
 
+#include "nav2_map_server/binary_map.hpp"
 #include "nav2_map_server/occ_grid_loader.hpp"
 #include "test_constants/test_constants.h"
 
@@ -131,6 +132,32 @@ TEST_F(MapLoaderTest, loadValidBMP)
   }
 }
 
+/* Save a loaded PNG in the binary map format and load it back.  Succeeds if
+ * the reloaded map matches the original exactly. */
+
+TEST_F(MapLoaderTest, loadValidBinary)
+{
+  auto test_png = path(TEST_DIR) / path(g_valid_png_file);
+  ASSERT_NO_THROW(map_loader_->loadMapFromFile(test_png.string()));
+  nav_msgs::msg::OccupancyGrid png_msg = map_loader_->getOccupancyGrid();
+
+  auto test_bin = std::experimental::filesystem::temp_directory_path() / path("testmap.bin");
+  ASSERT_TRUE(nav2_map_server::saveBinaryMap(test_bin.string(), png_msg));
+  EXPECT_TRUE(nav2_map_server::isBinaryMapFile(test_bin.string()));
+  EXPECT_FALSE(nav2_map_server::isBinaryMapFile(test_png.string()));
+
+  TestMapLoader bin_loader(node_.get(), doc_);
+  ASSERT_NO_THROW(bin_loader.loadMapFromFile(test_bin.string()));
+  nav_msgs::msg::OccupancyGrid map_msg = bin_loader.getOccupancyGrid();
+  std::experimental::filesystem::remove(test_bin);
+
+  EXPECT_EQ(map_msg.info.resolution, png_msg.info.resolution);
+  EXPECT_EQ(map_msg.info.width, g_valid_image_width);
+  EXPECT_EQ(map_msg.info.height, g_valid_image_height);
+  EXPECT_EQ(map_msg.info.origin, png_msg.info.origin);
+  EXPECT_EQ(map_msg.data, png_msg.data);
+}
+
 /* Try to load an invalid file.  Succeeds if a std::runtime exception is thrown */
 
 TEST_F(MapLoaderTest, loadInvalidFile)
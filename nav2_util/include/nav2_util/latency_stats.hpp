@@ -0,0 +1,88 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_UTIL__LATENCY_STATS_HPP_
+#define NAV2_UTIL__LATENCY_STATS_HPP_
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+namespace nav2_util
+{
+
+/// @brief Keeps the most recent durations of an operation and reports their distribution
+class LatencyStats
+{
+public:
+  /// @param window Number of most recent samples the percentiles are computed over
+  explicit LatencyStats(size_t window = 1000)
+  : window_(std::max<size_t>(window, 1)), next_(0), total_count_(0) {}
+
+  /// @brief Record a duration, in seconds
+  void add(double seconds)
+  {
+    if (samples_.size() < window_) {
+      samples_.push_back(seconds);
+    } else {
+      samples_[next_] = seconds;
+      next_ = (next_ + 1) % window_;
+    }
+    ++total_count_;
+  }
+
+  /// @brief Number of samples in the window
+  size_t count() const {return samples_.size();}
+
+  /// @brief Number of samples recorded since the last clear
+  uint64_t totalCount() const {return total_count_;}
+
+  /// @brief The given percentile, in [0, 100], of the samples in the window (0 when empty)
+  double percentile(double p) const
+  {
+    if (samples_.empty()) {
+      return 0.0;
+    }
+    sorted_ = samples_;
+    size_t rank = static_cast<size_t>(std::min(std::max(p, 0.0), 100.0) / 100.0 *
+      (sorted_.size() - 1) + 0.5);
+    std::nth_element(sorted_.begin(), sorted_.begin() + rank, sorted_.end());
+    return sorted_[rank];
+  }
+
+  /// @brief Largest sample in the window (0 when empty)
+  double max() const
+  {
+    return samples_.empty() ? 0.0 : *std::max_element(samples_.begin(), samples_.end());
+  }
+
+  void clear()
+  {
+    samples_.clear();
+    next_ = 0;
+    total_count_ = 0;
+  }
+
+protected:
+  size_t window_;
+  size_t next_;
+  uint64_t total_count_;
+  std::vector<double> samples_;
+  // Scratch space for the percentiles
+  mutable std::vector<double> sorted_;
+};
+
+}  // namespace nav2_util
+
+#endif  // NAV2_UTIL__LATENCY_STATS_HPP_
@@ -42,20 +42,6 @@ struct _rtk_fig_t;
 #define MAP_WIFI_MAX_LEVELS 8
 
 
-// Description for a single map cell.
-typedef struct
-{
-  // Occupancy state (-1 = free, 0 = unknown, +1 = occ)
-  int occ_state;
-
-  // Distance to the nearest occupied cell
-  double occ_dist;
-
-  // Wifi levels
-  // int wifi_levels[MAP_WIFI_MAX_LEVELS];
-} map_cell_t;
-
-
 // Description for a map
 typedef struct
 {
@@ -68,11 +54,37 @@ typedef struct
   // Map dimensions (number of cells)
   int size_x, size_y;
 
-  // The map data, stored as a grid
-  map_cell_t * cells;
+  // Number of the map_alloc_cells() call that allocated the cells, unique
+  // within the process. Unlike the map's address, it is never reused, so it
+  // tells tables derived from a freed map apart from those of a new one.
+  uint64_t generation;
+
+  // The map data, stored as a grid with one array per field so that each
+  // user only pulls the field it reads through the cache. Both arrays are
+  // indexed with MAP_INDEX.
+
+  // Occupancy state of every cell (-1 = free, 0 = unknown, +1 = occ)
+  int8_t * occ_state;
+
+  // Distance of every cell to the nearest occupied cell. There is one extra
+  // entry past the last cell, which map_update_cspace() sets to max_occ_dist,
+  // so that off-map lookups can be redirected to it without a branch.
+  float * occ_dist;
+
+  // Chessboard distance, in cells, from every cell to the nearest cell that
+  // stops a ray (anything but free space, or the outside of the map),
+  // saturated at 255. It lets map_calc_range() skip over free space. NULL
+  // until map_update_free_dist() is called.
+  uint8_t * free_dist;
+
+  // Indices (MAP_INDEX) of all the free cells, so that a free cell can be
+  // drawn uniformly in constant time. NULL until map_update_free_cells() is
+  // called.
+  int * free_cells;
+  int free_count;
 
   // Max distance at which we care about obstacles, for constructing
-  // likelihood field
+  // likelihood field. Negative until the cspace has been computed.
   double max_occ_dist;
 } map_t;
 
@@ -87,8 +99,12 @@ map_t * map_alloc(void);
 // Destroy a map
 void map_free(map_t * map);
 
-// Get the cell at the given point
-map_cell_t * map_get_cell(map_t * map, double ox, double oy, double oa);
+// Allocate the cells of a map of the given dimensions. The cells are
+// unknown, at distance 0. Returns 0 on success.
+int map_alloc_cells(map_t * map, int size_x, int size_y);
+
+// Get the index of the cell at the given point, or -1 if it is off the map
+int map_get_cell_index(map_t * map, double ox, double oy, double oa);
 
 // Load an occupancy map
 int map_load_occ(map_t * map, const char * filename, double scale, int negate);
@@ -99,6 +115,39 @@ int map_load_occ(map_t * map, const char * filename, double scale, int negate);
 // Update the cspace distances
 void map_update_cspace(map_t * map, double max_occ_dist);
 
+// Update the cspace distances after the occupancy states of the cells in
+// [min_i, max_i] x [min_j, max_j] changed, keeping max_occ_dist. Only the cells
+// whose distance may have changed are recomputed. Does nothing if the cspace
+// hasn't been computed yet.
+void map_update_cspace_region(map_t * map, int min_i, int min_j, int max_i, int max_j);
+
+// Update the index of free cells from the occupancy states. Returns the
+// number of free cells.
+int map_update_free_cells(map_t * map);
+
+// Update the index of free cells after the occupancy states of the cells in
+// [min_i, max_i] x [min_j, max_j] changed. Only the rows of the region are
+// scanned. Returns the number of free cells.
+int map_update_free_cells_region(map_t * map, int min_i, int min_j, int max_i, int max_j);
+
+
+/**************************************************************************
+ * Cspace cache functions
+ **************************************************************************/
+
+// Compute the key identifying the cspace of this map for the given
+// max_occ_dist, from the occupancy states and the map geometry
+uint64_t map_cspace_key(map_t * map, double max_occ_dist);
+
+// Load the cspace distances from a file written by map_save_cspace(). The
+// file is memory mapped and only used if it was saved with the same key and
+// geometry. Returns 0 on success.
+int map_load_cspace(map_t * map, uint64_t key, const char * filename);
+
+// Save the cspace distances computed by map_update_cspace(). Returns 0 on
+// success.
+int map_save_cspace(map_t * map, uint64_t key, const char * filename);
+
 
 /**************************************************************************
  * Range functions
@@ -107,6 +156,17 @@ void map_update_cspace(map_t * map, double max_occ_dist);
 // Extract a single range reading from the map
 double map_calc_range(map_t * map, double ox, double oy, double oa, double max_range);
 
+// Update the free space distances used to accelerate map_calc_range().
+// Returns 0 on success. If memory runs out, the distances are dropped and
+// map_calc_range() works without them.
+int map_update_free_dist(map_t * map);
+
+// Update the free space distances after the occupancy states of the cells in
+// [min_i, max_i] x [min_j, max_j] changed. Only the cells within 255 cells of
+// the region are recomputed. Does nothing if they haven't been computed yet.
+// Returns 0 on success, and drops the distances like map_update_free_dist().
+int map_update_free_dist_region(map_t * map, int min_i, int min_j, int max_i, int max_j);
+
 
 /**************************************************************************
  * GUI/diagnostic functions
@@ -142,6 +202,17 @@ void map_draw_wifi(map_t * map, struct _rtk_fig_t * fig, int index);
 
 #ifdef __cplusplus
 }
+
+namespace nav2_util
+{
+class WorkerPool;
+}
+
+// Variants of the cspace updates that split large windows over the given pool
+// instead of starting threads of their own. Small windows run on the caller.
+void map_update_cspace(map_t * map, double max_occ_dist, nav2_util::WorkerPool * pool);
+void map_update_cspace_region(
+  map_t * map, int min_i, int min_j, int max_i, int max_j, nav2_util::WorkerPool * pool);
 #endif
 
 #endif  // NAV2_UTIL__MAP__MAP_HPP_
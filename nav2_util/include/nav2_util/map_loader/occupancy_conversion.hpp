@@ -0,0 +1,53 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_UTIL__MAP_LOADER__OCCUPANCY_CONVERSION_HPP_
+#define NAV2_UTIL__MAP_LOADER__OCCUPANCY_CONVERSION_HPP_
+
+#include <stdint.h>
+
+#include "nav2_util/map_loader/map_loader.hpp"
+
+namespace map_loader
+{
+
+/**
+ * @brief Convert the pixels of an image to OccupancyGrid values
+ *
+ * The value of a pixel only depends on the sum of its averaged channels and on
+ * whether it is transparent, so the values are computed once per possible sum
+ * and every pixel becomes a table lookup. Multi-channel images are converted
+ * with one shard of rows per core.
+ *
+ * @param pixels The first row of the image
+ * @param width Width of the image in pixels
+ * @param height Height of the image in pixels
+ * @param rowstride Distance between the starts of two rows in bytes
+ * @param n_channels Bytes per pixel. The last byte is read as alpha when there are several.
+ * @param has_alpha If true, the alpha channel is left out of the average, unless in TRINARY mode
+ * @param negate If true, then whiter pixels are occupied, and blacker pixels are free
+ * @param occupancy_threshold Threshold above which pixels are occupied
+ * @param free_threshold Threshold below which pixels are free
+ * @param mode Map mode
+ * @param data Output of width * height values. Rows are flipped, so that cell (0,0)
+ *             is the lower-left corner of the image.
+ */
+void convertImageToOccupancy(
+  const unsigned char * pixels, int width, int height, int rowstride, int n_channels,
+  bool has_alpha, bool negate, double occupancy_threshold, double free_threshold,
+  MapMode mode, int8_t * data);
+
+}  // namespace map_loader
+
+#endif  // NAV2_UTIL__MAP_LOADER__OCCUPANCY_CONVERSION_HPP_
@@ -15,9 +15,13 @@
 #ifndef NAV2_UTIL__MOTION_MODEL__MOTION_MODEL_HPP_
 #define NAV2_UTIL__MOTION_MODEL__MOTION_MODEL_HPP_
 
+#include <stdint.h>
+#include <random>
 #include <string>
+#include <vector>
 #include "nav2_util/pf/pf.hpp"
 #include "nav2_util/pf/pf_pdf.hpp"
+#include "nav2_util/random.hpp"
 
 namespace nav2_util
 {
@@ -25,8 +29,26 @@ namespace nav2_util
 class MotionModel
 {
 public:
+  MotionModel()
+  : rng_(std::random_device{}()) {}
   virtual ~MotionModel() = default;
   virtual void odometryUpdate(pf_t * pf, const pf_vector_t & pose, const pf_vector_t & delta) = 0;
+
+  // Seed the generator of the motion noise, to reproduce a run
+  void setSeed(uint64_t seed) {rng_.seed(seed);}
+
+protected:
+  // Draw count standard normal values for each of the samples of the set.
+  // Draw k of sample i is at noise_[k * sample_count + i].
+  const double * drawNoise(int sample_count, int count)
+  {
+    noise_.resize(static_cast<size_t>(sample_count) * count);
+    rng_.gaussian(noise_.data(), noise_.size());
+    return noise_.data();
+  }
+
+  Xoshiro256 rng_;
+  std::vector<double> noise_;
 };
 
 class OmniMotionModel : public MotionModel
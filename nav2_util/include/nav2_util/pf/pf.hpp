@@ -29,7 +29,7 @@
 #define NAV2_UTIL__PF__PF_HPP_
 
 #include "nav2_util/pf/pf_vector.hpp"
-#include "nav2_util/pf/pf_kdtree.hpp"
+#include "nav2_util/pf/pf_hashgrid.hpp"
 
 #ifdef __cplusplus
 extern "C" {
@@ -57,7 +57,7 @@ typedef double (* pf_sensor_model_fn_t) (
   struct _pf_sample_set_t * set);
 
 
-// Information for a single sample
+// Information for a single sample, as read with pf_sample_get()
 typedef struct
 {
   // Pose represented by this sample
@@ -89,12 +89,19 @@ typedef struct
 // Information for a set of samples
 typedef struct _pf_sample_set_t
 {
-  // The samples
+  // The samples, stored as a structure of arrays: sample i has the pose
+  // (x[i], y[i], theta[i]) and the weight weight[i]. Each array is 64-byte
+  // aligned, so a pass over the samples only streams the fields it uses and
+  // its loop can be vectorized.
   int sample_count;
-  pf_sample_t * samples;
+  double * x, * y, * theta;
+  double * weight;
 
-  // A kdtree encoding the histogram
-  pf_kdtree_t * kdtree;
+  // A hash grid encoding the histogram
+  pf_hashgrid_t * histogram;
+
+  // The histogram bin of every sample, recorded when the sample is inserted
+  int * sample_bins;
 
   // Clusters
   int cluster_count, cluster_max_count;
@@ -107,6 +114,34 @@ typedef struct _pf_sample_set_t
 } pf_sample_set_t;
 
 
+// Get the pose of a sample
+static inline pf_vector_t pf_sample_pose(const pf_sample_set_t * set, int i)
+{
+  pf_vector_t pose;
+  pose.v[0] = set->x[i];
+  pose.v[1] = set->y[i];
+  pose.v[2] = set->theta[i];
+  return pose;
+}
+
+// Set the pose of a sample
+static inline void pf_sample_set_pose(pf_sample_set_t * set, int i, pf_vector_t pose)
+{
+  set->x[i] = pose.v[0];
+  set->y[i] = pose.v[1];
+  set->theta[i] = pose.v[2];
+}
+
+// Get the pose and weight of a sample
+static inline pf_sample_t pf_sample_get(const pf_sample_set_t * set, int i)
+{
+  pf_sample_t sample;
+  sample.pose = pf_sample_pose(set, i);
+  sample.weight = set->weight[i];
+  return sample;
+}
+
+
 // Information for an entire filter
 typedef struct _pf_t
 {
@@ -134,6 +169,25 @@ typedef struct _pf_t
   double dist_threshold;  // distance threshold in each axis over which the pf is considered to not
                           // be converged
   int converged;
+
+  // Required number of samples for every possible number of histogram bins,
+  // and the population size parameters it was computed for
+  int * limit_cache;
+  double limit_cache_err, limit_cache_z;
+
+  // Alias table (Walker/Vose) used to draw samples in constant time while
+  // resampling, and its work list
+  double * alias_prob;
+  int * alias_index;
+  int * alias_work;
+
+  // Work arrays of pf_update_sensors, sized like the sample sets
+  double * prior_weights;
+  double * log_weights;
+
+  // Time spent in the last pf_cluster_stats() call, in seconds, so that
+  // callers can tell it apart from the rest of a resampling step
+  double cluster_stats_time;
 } pf_t;
 
 
@@ -158,6 +212,11 @@ void pf_update_action(pf_t * pf, pf_action_model_fn_t action_fn, void * action_d
 // Update the filter with some new sensor observation
 void pf_update_sensor(pf_t * pf, pf_sensor_model_fn_t sensor_fn, void * sensor_data);
 
+// Update the filter with the observations of several sensors, taken at about
+// the same time, as a single observation
+void pf_update_sensors(
+  pf_t * pf, int sensor_count, pf_sensor_model_fn_t sensor_fns[], void * sensor_data[]);
+
 // Resample the distribution
 void pf_update_resample(pf_t * pf);
 
@@ -170,14 +229,30 @@ int pf_get_cluster_stats(
   pf_t * pf, int cluster, double * weight,
   pf_vector_t * mean, pf_matrix_t * cov);
 
-// Re-compute the cluster statistics for a sample set
+// Re-compute the cluster statistics for a sample set. The samples must not
+// have moved since they were inserted in the histogram.
 void pf_cluster_stats(pf_t * pf, pf_sample_set_t * set);
 
+// Compute the required number of samples, given that there are k bins
+// with samples in them.
+int pf_resample_limit(pf_t * pf, int k);
+
+// Make sure the table of pf_resample_limit() values matches the population
+// size parameters, which callers may change at any time.
+void pf_update_limit_cache(pf_t * pf);
+
+// Build the alias table for the weights of the given set
+void pf_build_alias_table(pf_t * pf, pf_sample_set_t * set);
+
+// Draw the index of a sample from the alias table of a set of n samples.
+// Uses drand48().
+int pf_draw_alias_sample(pf_t * pf, int n);
+
 
 // Display the sample set
 void pf_draw_samples(pf_t * pf, struct _rtk_fig_t * fig, int max_samples);
 
-// Draw the histogram (kdtree)
+// Draw the histogram
 void pf_draw_hist(pf_t * pf, struct _rtk_fig_t * fig);
 
 // Draw the CEP statistics
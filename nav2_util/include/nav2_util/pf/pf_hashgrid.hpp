@@ -0,0 +1,102 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_UTIL__PF__PF_HASHGRID_HPP_
+#define NAV2_UTIL__PF__PF_HASHGRID_HPP_
+
+#include "nav2_util/pf/pf_vector.hpp"
+
+#ifdef INCLUDE_RTKGUI
+#include <rtk.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An occupied bin of the histogram
+typedef struct
+{
+  // The grid coordinates of the bin
+  int key[3];
+
+  // The accumulated value of the poses in this bin
+  double value;
+
+  // The cluster label
+  int cluster;
+
+  // The hash table slot referring to this bin
+  int slot;
+} pf_hashgrid_bin_t;
+
+
+// A pose histogram stored as an open-addressing hash table over grid cells.
+// It replaces the kd-tree of the original implementation: inserts are O(1) and the
+// occupied bins are kept densely packed, in insertion order, in the bins array.
+typedef struct
+{
+  // Cell size
+  double size[3];
+
+  // The occupied bins
+  int bin_count, bin_max_count;
+  pf_hashgrid_bin_t * bins;
+
+  // Hash table of bin indices (-1 for empty slots); the size is a power of two
+  // kept at least twice bin_max_count
+  int slot_mask;
+  int * slots;
+
+  // Union-find forest over the bins used for clustering, sized like bins
+  int * parent;
+} pf_hashgrid_t;
+
+
+// Create a histogram able to hold max_size bins before growing
+extern pf_hashgrid_t * pf_hashgrid_alloc(int max_size);
+
+// Destroy a histogram
+extern void pf_hashgrid_free(pf_hashgrid_t * self);
+
+// Clear all entries from the histogram
+extern void pf_hashgrid_clear(pf_hashgrid_t * self);
+
+// Insert a pose into the histogram and return the index of its bin. The index
+// stays valid until the histogram is cleared.
+extern int pf_hashgrid_insert(pf_hashgrid_t * self, pf_vector_t pose, double value);
+
+// Cluster the occupied bins and return the number of clusters. Cluster labels
+// are numbered in the order of the first bin of each cluster.
+extern int pf_hashgrid_cluster(pf_hashgrid_t * self);
+
+// Determine the probability estimate for the given pose
+extern double pf_hashgrid_get_prob(pf_hashgrid_t * self, pf_vector_t pose);
+
+// Determine the cluster label for the given pose
+extern int pf_hashgrid_get_cluster(pf_hashgrid_t * self, pf_vector_t pose);
+
+
+#ifdef INCLUDE_RTKGUI
+
+// Draw the histogram
+extern void pf_hashgrid_draw(pf_hashgrid_t * self, rtk_fig_t * fig);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // NAV2_UTIL__PF__PF_HASHGRID_HPP_
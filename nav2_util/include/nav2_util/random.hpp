@@ -0,0 +1,131 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_UTIL__RANDOM_HPP_
+#define NAV2_UTIL__RANDOM_HPP_
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nav2_util
+{
+
+/**
+ * @class Xoshiro256
+ * @brief Small, fast and seedable pseudo random number generator (xoshiro256++)
+ *
+ * Unlike drand48 the state is held by the object, so every thread can own a
+ * generator and a fixed seed reproduces the same stream. Independent streams
+ * for several threads can be derived from one seed with jump().
+ */
+class Xoshiro256
+{
+public:
+  explicit Xoshiro256(uint64_t seed = 0) {this->seed(seed);}
+
+  /// @brief Reset the state from a 64 bit seed, expanded with splitmix64
+  void seed(uint64_t seed)
+  {
+    for (int i = 0; i < 4; i++) {
+      seed += 0x9e3779b97f4a7c15ULL;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      s_[i] = z ^ (z >> 31);
+    }
+  }
+
+  /// @brief The next 64 random bits
+  uint64_t operator()()
+  {
+    const uint64_t result = rotl(s_[0] + s_[3], 23) + s_[0];
+    const uint64_t t = s_[1] << 17;
+
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = rotl(s_[3], 45);
+
+    return result;
+  }
+
+  /// @brief A uniform double in [0, 1)
+  double uniform()
+  {
+    return static_cast<double>((*this)() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  /**
+   * @brief Fill a buffer with independent standard normal draws
+   *
+   * Uses the polar Box-Muller method and keeps both values of every pair, so
+   * there is one log and one sqrt for every two numbers.
+   */
+  void gaussian(double * out, size_t count)
+  {
+    size_t i = 0;
+    while (i < count) {
+      double x1, x2, w;
+      do {
+        x1 = 2.0 * uniform() - 1.0;
+        x2 = 2.0 * uniform() - 1.0;
+        w = x1 * x1 + x2 * x2;
+      } while (w >= 1.0 || w == 0.0);
+
+      const double f = sqrt(-2.0 * log(w) / w);
+      out[i++] = x1 * f;
+      if (i < count) {
+        out[i++] = x2 * f;
+      }
+    }
+  }
+
+  /// @brief Advance the state by 2^128 draws, to split one seed into non-overlapping streams
+  void jump()
+  {
+    static const uint64_t jump_poly[4] = {
+      0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+      0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+
+    uint64_t s[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+      for (int b = 0; b < 64; b++) {
+        if (jump_poly[i] & (1ULL << b)) {
+          for (int k = 0; k < 4; k++) {
+            s[k] ^= s_[k];
+          }
+        }
+        (*this)();
+      }
+    }
+    for (int k = 0; k < 4; k++) {
+      s_[k] = s[k];
+    }
+  }
+
+private:
+  static uint64_t rotl(uint64_t x, int k)
+  {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  uint64_t s_[4];
+};
+
+}  // namespace nav2_util
+
+#endif  // NAV2_UTIL__RANDOM_HPP_
@@ -15,10 +15,14 @@
 #ifndef NAV2_UTIL__SENSORS__LASER__LASER_HPP_
 #define NAV2_UTIL__SENSORS__LASER__LASER_HPP_
 
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 #include "nav2_util/pf/pf.hpp"
 #include "nav2_util/pf/pf_pdf.hpp"
 #include "nav2_util/map/map.hpp"
+#include "nav2_util/worker_pool.hpp"
 
 namespace nav2_util
 {
@@ -26,15 +30,98 @@ namespace nav2_util
 // Forward declarations
 class LaserData;
 
+/**
+ * @struct LikelihoodField
+ * @brief Per-cell beam likelihood of a map, and the parameters it was computed for
+ *
+ * Lasers on the same map with the same model parameters share one table. Like the
+ * map's occ_dist, it has an extra last entry for off-map hits.
+ */
+struct LikelihoodField
+{
+  map_t * map;
+  uint64_t map_generation;
+  double z_hit;
+  double z_rand;
+  double sigma_hit;
+  double max_occ_dist;
+  double range_max;
+  bool log_scale;
+  std::vector<float> values;
+
+  /// @brief Compute the entries [begin, end) from the map's cspace distances
+  void fill(int begin, int end);
+};
+
 class Laser
 {
 public:
   Laser(size_t max_beams, map_t * map);
   virtual ~Laser();
   virtual bool sensorUpdate(pf_t * pf, LaserData * data) = 0;
+
+  /**
+   * @brief Weigh the particles with the scans of several lasers as one observation
+   *
+   * The scans should be taken at about the same time. Each laser weighs the particles
+   * on its own, and their joint likelihood is applied at once, so the filter goes
+   * through a single normalization and the caller needs a single resample.
+   */
+  static bool fusedSensorUpdate(pf_t * pf, const std::vector<LaserData *> & data);
   void SetLaserPose(pf_vector_t & laser_pose);
 
+  /**
+   * @brief Weigh the particles in parallel on the given pool
+   *
+   * The pool may be shared between lasers since the sensor updates run one at a time.
+   * Passing nullptr restores the serial update.
+   */
+  void setWorkerPool(std::shared_ptr<WorkerPool> pool);
+
+  /**
+   * @brief Choose how the beams weighed by the model are picked from each scan
+   *
+   * By default the beams are taken at a fixed stride. With adaptive selection, max range
+   * readings and readings that end in the same cell as the previous one are dropped, and
+   * up to max_beams of the rest are chosen to spread over both the bearings and the
+   * orientations of the surfaces they hit. Only the likelihood field models use it.
+   */
+  void setAdaptiveBeamSelection(bool adaptive);
+
+  /**
+   * @brief Refresh the likelihood fields of a map after it changed in place
+   *
+   * The occupancy states of the cells in [min_i, max_i] x [min_j, max_j] changed and
+   * the map's cspace distances were updated for them. Every table in use for the map
+   * is refreshed once, and only for the cells within max_occ_dist of the region.
+   */
+  static void updateMapRegion(map_t * map, int min_i, int min_j, int max_i, int max_j);
+
 protected:
+  // The sensor model function of the laser, or NULL if it can't weigh the particles
+  virtual pf_sensor_model_fn_t sensorModel() const = 0;
+
+  // Signature of the per-shard weighting functions. Returns the sum of the new
+  // weights of the samples in [begin, end).
+  using WeighFn = std::function<double (unsigned int lane, int begin, int end)>;
+
+  // Run fn over the samples of the set, sharded across the worker pool, and reduce the
+  // per-lane partial sums in lane order
+  double weighSamples(pf_sample_set_t * set, const WeighFn & fn);
+
+  // Number of shards weighSamples can split a set into
+  unsigned int laneCount() const {return pool_ ? pool_->size() : 1;}
+
+  // Make sure likelihood_field_ holds, for every map cell, the likelihood that a beam
+  // of a scan with the given max range ends there (or its log if log_scale is set).
+  // The table is shared with the other lasers on the map that use the same parameters,
+  // and only built when no such laser has one.
+  void updateLikelihoodField(double range_max, bool log_scale);
+
+  // Fill beams_ with the indices of the scan readings to weigh, either every step-th
+  // reading or, with adaptive selection, the most informative ones. Called once per scan.
+  void selectBeams(LaserData * data, int step);
+
   double z_hit_;
   double z_rand_;
   double sigma_hit_;
@@ -46,19 +133,40 @@ protected:
   int max_samples_;
   int max_obs_;
   double ** temp_obs_;
+
+  std::shared_ptr<WorkerPool> pool_;
+  std::vector<double> lane_totals_;
+
+  // Per-cell beam likelihood for the current scan parameters
+  std::shared_ptr<LikelihoodField> likelihood_field_;
+
+  // Beams chosen by selectBeams, and its scratch space
+  bool adaptive_beams_;
+  std::vector<int> beams_;
+  std::vector<int> beam_candidates_;
+  std::vector<double> beam_points_;
+  std::vector<double> beam_features_;
+  std::vector<double> beam_spread_;
 };
 
 class LaserData
 {
 public:
   Laser * laser;
-  LaserData() {ranges = NULL;}
+  LaserData() {ranges = NULL; range_capacity_ = 0;}
   virtual ~LaserData() {delete[] ranges;}
 
+  // Set range_count and make room for that many ranges. The buffer is kept across
+  // scans and only reallocated when a scan has more ranges than any before it.
+  void resizeRanges(int count);
+
 public:
   int range_count;
   double range_max;
   double(*ranges)[2];
+
+private:
+  int range_capacity_;
 };
 
 
@@ -70,8 +178,12 @@ public:
     double lambda_short, double chi_outlier, size_t max_beams, map_t * map);
   bool sensorUpdate(pf_t * pf, LaserData * data);
 
+protected:
+  pf_sensor_model_fn_t sensorModel() const;
+
 private:
   static double sensorFunction(LaserData * data, pf_sample_set_t * set);
+  double weighSampleRange(LaserData * data, pf_sample_set_t * set, int begin, int end);
   double z_short_;
   double z_max_;
   double lambda_short_;
@@ -86,8 +198,26 @@ public:
     size_t max_beams, map_t * map);
   bool sensorUpdate(pf_t * pf, LaserData * data);
 
+protected:
+  pf_sensor_model_fn_t sensorModel() const;
+
 private:
   static double sensorFunction(LaserData * data, pf_sample_set_t * set);
+  double weighSampleRange(pf_sample_set_t * set, unsigned int lane, int begin, int end);
+
+  // Convert the beams of the scan used by this model into grid offsets in the laser frame
+  void prepareBeams(LaserData * data);
+
+  // Score the prepared beams from the given laser pose, using cells as scratch space
+  double scoreBeams(const pf_vector_t & pose, int * cells) const;
+
+  // Beam endpoints of the current scan in the laser frame, in cells
+  std::vector<double> beam_gx_;
+  std::vector<double> beam_gy_;
+  int beam_count_;
+
+  // Per-lane cell index scratch for scoreBeams
+  std::vector<int> lane_cells_;
 };
 
 class LikelihoodFieldModelProb : public Laser
@@ -100,12 +230,19 @@ public:
     size_t max_beams, map_t * map);
   bool sensorUpdate(pf_t * pf, LaserData * data);
 
+protected:
+  pf_sensor_model_fn_t sensorModel() const;
+
 private:
   static double sensorFunction(LaserData * data, pf_sample_set_t * set);
   bool do_beamskip_;
   double beam_skip_distance_;
   double beam_skip_threshold_;
   double beam_skip_error_threshold_;
+
+  // Beam skipping work arrays, kept across scans
+  std::vector<int> obs_count_;
+  std::vector<char> obs_mask_;
 };
 
 }  // namespace nav2_util
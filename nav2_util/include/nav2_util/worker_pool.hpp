@@ -0,0 +1,93 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_UTIL__WORKER_POOL_HPP_
+#define NAV2_UTIL__WORKER_POOL_HPP_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nav2_util
+{
+
+/**
+ * @class WorkerPool
+ * @brief A fixed set of threads that split an index range into contiguous shards
+ *
+ * The calling thread always works on the first shard itself, so a pool of size N
+ * keeps N - 1 background threads. The shard boundaries only depend on the range
+ * and the pool size, which keeps reductions over per-lane results deterministic.
+ */
+class WorkerPool
+{
+public:
+  /**
+   * @brief Task run on a shard
+   * @param lane Index of the shard in [0, size())
+   * @param begin First index of the shard
+   * @param end One past the last index of the shard
+   */
+  using Task = std::function<void (unsigned int lane, int begin, int end)>;
+
+  /**
+   * @brief Create a pool
+   * @param num_threads Total number of lanes, including the caller. 0 uses one lane per core.
+   */
+  explicit WorkerPool(unsigned int num_threads = 0);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool & operator=(const WorkerPool &) = delete;
+
+  /// @brief The number of lanes, i.e. the maximum number of shards of a range
+  unsigned int size() const {return workers_.size() + 1;}
+
+  /**
+   * @brief Run the task over [0, count) and block until every shard is done
+   * @param count Size of the range
+   * @param task Task run once per non-empty shard
+   * @param min_shard Ranges are not split into shards smaller than this
+   * @return The number of lanes that were used
+   */
+  unsigned int run(int count, const Task & task, int min_shard = 1);
+
+  /// @brief The beginning of the given shard when [0, count) is split over lanes
+  static int shardBegin(int count, unsigned int lane, unsigned int lanes)
+  {
+    return static_cast<int>(static_cast<long long>(count) * lane / lanes);
+  }
+
+protected:
+  void workerLoop(unsigned int lane);
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+
+  // State of the job in flight, protected by mutex_
+  const Task * task_;
+  int count_;
+  unsigned int lanes_;
+  unsigned int pending_;
+  unsigned long generation_;
+  bool stop_;
+};
+
+}  // namespace nav2_util
+
+#endif  // NAV2_UTIL__WORKER_POOL_HPP_
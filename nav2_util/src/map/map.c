@@ -48,10 +48,16 @@ map_t * map_alloc(void)
   // Make the size odd
   map->size_x = 0;
   map->size_y = 0;
+  map->generation = 0;
   map->scale = 0;
+  map->max_occ_dist = -1;
 
   // Allocate storage for main map
-  map->cells = (map_cell_t *) NULL;
+  map->occ_state = (int8_t *) NULL;
+  map->occ_dist = (float *) NULL;
+  map->free_dist = (uint8_t *) NULL;
+  map->free_cells = (int *) NULL;
+  map->free_count = 0;
 
   return map;
 }
@@ -60,25 +66,161 @@ map_t * map_alloc(void)
 // Destroy a map
 void map_free(map_t * map)
 {
-  free(map->cells);
+  free(map->occ_state);
+  free(map->occ_dist);
+  free(map->free_dist);
+  free(map->free_cells);
   free(map);
 }
 
 
-// Get the cell at the given point
-map_cell_t * map_get_cell(map_t * map, double ox, double oy, double oa)
+// Number of map_alloc_cells() calls so far
+static uint64_t map_generations = 0;
+
+// Allocate the cells of a map of the given dimensions
+int map_alloc_cells(map_t * map, int size_x, int size_y)
+{
+  free(map->occ_state);
+  free(map->occ_dist);
+  free(map->free_dist);
+  map->free_dist = NULL;
+  free(map->free_cells);
+  map->free_cells = NULL;
+  map->free_count = 0;
+  map->max_occ_dist = -1;
+
+  map->size_x = size_x;
+  map->size_y = size_y;
+  map->generation = __atomic_add_fetch(&map_generations, 1, __ATOMIC_RELAXED);
+  map->occ_state = (int8_t *) calloc(size_x * size_y, sizeof(map->occ_state[0]));
+  map->occ_dist = (float *) calloc(size_x * size_y + 1, sizeof(map->occ_dist[0]));
+
+  if (map->occ_state == NULL || map->occ_dist == NULL) {
+    return -1;
+  }
+  return 0;
+}
+
+
+// Update the index of free cells. The cells are counted first so that the
+// index takes exactly one int per free cell.
+int map_update_free_cells(map_t * map)
+{
+  int i, n, count;
+
+  n = map->size_x * map->size_y;
+
+  count = 0;
+  for (i = 0; i < n; i++) {
+    count += (map->occ_state[i] == -1);
+  }
+
+  free(map->free_cells);
+  map->free_cells = (int *) malloc(count * sizeof(map->free_cells[0]));
+  map->free_count = 0;
+  if (map->free_cells == NULL) {
+    return 0;
+  }
+
+  for (i = 0; i < n; i++) {
+    if (map->occ_state[i] == -1) {
+      map->free_cells[map->free_count++] = i;
+    }
+  }
+  return map->free_count;
+}
+
+
+// Position of the first entry of the sorted array cells[0, count) that is not
+// less than index
+static int map_lower_bound(const int * cells, int count, int index)
+{
+  int begin = 0, end = count;
+  while (begin < end) {
+    int mid = begin + (end - begin) / 2;
+    if (cells[mid] < index) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  return begin;
+}
+
+
+// Update the index of free cells after the occupancy states of the cells in
+// [min_i, max_i] x [min_j, max_j] changed. The index is sorted, so the entries
+// of the rows of the region form one run, which is rebuilt from those rows
+// alone; the entries after it are moved by the change in its length.
+int map_update_free_cells_region(map_t * map, int min_i, int min_j, int max_i, int max_j)
+{
+  int i, begin, end, first, last, count, total;
+  int * cells;
+
+  if (map->free_cells == NULL) {
+    return map_update_free_cells(map);
+  }
+
+  min_i = min_i > 0 ? min_i : 0;
+  min_j = min_j > 0 ? min_j : 0;
+  max_i = max_i < map->size_x - 1 ? max_i : map->size_x - 1;
+  max_j = max_j < map->size_y - 1 ? max_j : map->size_y - 1;
+  if (min_i > max_i || min_j > max_j) {
+    return map->free_count;
+  }
+
+  begin = MAP_INDEX(map, min_i, min_j);
+  end = MAP_INDEX(map, max_i, max_j) + 1;
+  first = map_lower_bound(map->free_cells, map->free_count, begin);
+  last = first + map_lower_bound(map->free_cells + first, map->free_count - first, end);
+
+  count = 0;
+  for (i = begin; i < end; i++) {
+    count += (map->occ_state[i] == -1);
+  }
+  total = map->free_count - (last - first) + count;
+
+  if (count < last - first) {
+    memmove(map->free_cells + first + count, map->free_cells + last,
+      (map->free_count - last) * sizeof(map->free_cells[0]));
+    // Shrinking can't fail in a way that matters, the old block stays valid
+    cells = (int *) realloc(map->free_cells, (total > 0 ? total : 1) * sizeof(cells[0]));
+    if (cells != NULL) {
+      map->free_cells = cells;
+    }
+  } else if (count > last - first) {
+    cells = (int *) realloc(map->free_cells, total * sizeof(cells[0]));
+    if (cells == NULL) {
+      return map_update_free_cells(map);
+    }
+    map->free_cells = cells;
+    memmove(map->free_cells + first + count, map->free_cells + last,
+      (map->free_count - last) * sizeof(map->free_cells[0]));
+  }
+
+  count = first;
+  for (i = begin; i < end; i++) {
+    if (map->occ_state[i] == -1) {
+      map->free_cells[count++] = i;
+    }
+  }
+  map->free_count = total;
+  return map->free_count;
+}
+
+
+// Get the index of the cell at the given point
+int map_get_cell_index(map_t * map, double ox, double oy, double oa)
 {
   (void)oa;
   int i, j;
-  map_cell_t * cell;
 
   i = MAP_GXWX(map, ox);
   j = MAP_GYWY(map, oy);
 
   if (!MAP_VALID(map, i, j)) {
-    return NULL;
+    return -1;
   }
 
-  cell = map->cells + MAP_INDEX(map, i, j);
-  return cell;
+  return MAP_INDEX(map, i, j);
 }
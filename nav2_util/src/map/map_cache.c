@@ -0,0 +1,167 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "nav2_util/map/map.hpp"
+
+// Layout of a cspace cache file: this header, followed by the
+// size_x * size_y + 1 entries of occ_dist, in native byte order
+typedef struct
+{
+  char magic[8];
+  uint64_t key;
+  int32_t size_x, size_y;
+  double scale;
+  double max_occ_dist;
+} map_cspace_header_t;
+
+static const char map_cspace_magic[8] = {'N', 'A', 'V', '2', 'C', 'S', 'P', '1'};
+
+
+// Fold a block of bytes into a FNV-1a hash
+static uint64_t map_hash_bytes(uint64_t hash, const void * data, size_t size)
+{
+  const unsigned char * bytes = (const unsigned char *) data;
+  size_t i;
+
+  for (i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+// Compute the key identifying the cspace of a map
+uint64_t map_cspace_key(map_t * map, double max_occ_dist)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  hash = map_hash_bytes(hash, &map->size_x, sizeof(map->size_x));
+  hash = map_hash_bytes(hash, &map->size_y, sizeof(map->size_y));
+  hash = map_hash_bytes(hash, &map->scale, sizeof(map->scale));
+  hash = map_hash_bytes(hash, &max_occ_dist, sizeof(max_occ_dist));
+  hash = map_hash_bytes(hash, map->occ_state, (size_t) map->size_x * map->size_y);
+  return hash;
+}
+
+
+// Load the cspace distances from a cache file
+int map_load_cspace(map_t * map, uint64_t key, const char * filename)
+{
+  int fd;
+  struct stat info;
+  size_t count, size;
+  void * data;
+  const map_cspace_header_t * header;
+  int result = -1;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+
+  count = (size_t) map->size_x * map->size_y + 1;
+  size = sizeof(map_cspace_header_t) + count * sizeof(map->occ_dist[0]);
+
+  if (fstat(fd, &info) != 0 || (size_t) info.st_size != size) {
+    close(fd);
+    return -1;
+  }
+
+  data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return -1;
+  }
+
+  header = (const map_cspace_header_t *) data;
+  if (memcmp(header->magic, map_cspace_magic, sizeof(map_cspace_magic)) == 0 &&
+    header->key == key && header->size_x == map->size_x && header->size_y == map->size_y &&
+    header->scale == map->scale)
+  {
+    memcpy(map->occ_dist, header + 1, count * sizeof(map->occ_dist[0]));
+    map->max_occ_dist = header->max_occ_dist;
+    result = 0;
+  }
+
+  munmap(data, size);
+  return result;
+}
+
+
+// Save the cspace distances to a cache file. The file is written under a
+// unique temporary name in the same directory and renamed, so readers never
+// see a partial file and concurrent writers don't write into the same file.
+int map_save_cspace(map_t * map, uint64_t key, const char * filename)
+{
+  FILE * file;
+  char * tmp_name;
+  int fd;
+  size_t count;
+  map_cspace_header_t header;
+  int ok;
+
+  tmp_name = (char *) malloc(strlen(filename) + 8);
+  if (tmp_name == NULL) {
+    return -1;
+  }
+  sprintf(tmp_name, "%s.XXXXXX", filename);
+
+  fd = mkstemp(tmp_name);
+  if (fd < 0) {
+    free(tmp_name);
+    return -1;
+  }
+  // mkstemp() creates the file readable by the owner only
+  fchmod(fd, 0644);
+
+  file = fdopen(fd, "wb");
+  if (file == NULL) {
+    close(fd);
+    remove(tmp_name);
+    free(tmp_name);
+    return -1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, map_cspace_magic, sizeof(map_cspace_magic));
+  header.key = key;
+  header.size_x = map->size_x;
+  header.size_y = map->size_y;
+  header.scale = map->scale;
+  header.max_occ_dist = map->max_occ_dist;
+
+  count = (size_t) map->size_x * map->size_y + 1;
+  ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+    fwrite(map->occ_dist, sizeof(map->occ_dist[0]), count, file) == count;
+  ok = (fclose(file) == 0) && ok;
+
+  if (ok) {
+    ok = rename(tmp_name, filename) == 0;
+  }
+  if (!ok) {
+    remove(tmp_name);
+  }
+
+  free(tmp_name);
+  return ok ? 0 : -1;
+}
@@ -20,159 +20,175 @@
  */
 
 #include <math.h>
-#include <stdlib.h>
-#include <string.h>
-#include <queue>
+#include <algorithm>
+#include <memory>
+#include <vector>
 #include "nav2_util/map/map.hpp"
-
-class CellData
-{
-public:
-  map_t * map_;
-  unsigned int i_, j_;
-  unsigned int src_i_, src_j_;
-};
-
-class CachedDistanceMap
+#include "nav2_util/worker_pool.hpp"
+
+// Windows with fewer cells than this are transformed on the calling thread
+static const long long map_cspace_parallel_cells = 256 * 256;
+
+// Compute the cspace distances of the cells in [out_x0, out_x1) x [out_y0, out_y1)
+// from the occupancy states in the window [x0, x1) x [y0, y1) around them. This
+// is an exact Euclidean distance transform in two separable passes
+// (Felzenszwalb & Huttenlocher): the distance to the nearest obstacle within
+// each column, then the lower envelope of the parabolas along each row. Both
+// passes are linear in the number of cells and independent across columns
+// (resp. rows), so they are split over a worker pool. The distances are exact
+// as long as the window reaches one cell past max_occ_dist beyond the output.
+static void map_cspace_window(
+  map_t * map, nav2_util::WorkerPool * pool, int x0, int y0, int x1, int y1,
+  int out_x0, int out_y0, int out_x1, int out_y1)
 {
-public:
-  CachedDistanceMap(double scale, double max_dist)
-  : distances_(NULL), scale_(scale), max_dist_(max_dist)
-  {
-    cell_radius_ = max_dist / scale;
-    distances_ = new double *[cell_radius_ + 2];
-    for (int i = 0; i <= cell_radius_ + 1; i++) {
-      distances_[i] = new double[cell_radius_ + 2];
-      for (int j = 0; j <= cell_radius_ + 1; j++) {
-        distances_[i][j] = sqrt(i * i + j * j);
-      }
-    }
+  const double max_occ_dist = map->max_occ_dist;
+  const int window_width = x1 - x0;
+  const int window_height = y1 - y0;
+
+  // Cells further than this from any obstacle are set to max_occ_dist. Column
+  // distances are saturated one cell past it, which keeps the squared
+  // distances small without changing which cells are in range.
+  const int cell_radius = static_cast<int>(max_occ_dist / map->scale);
+  const int cap = cell_radius + 1;
+
+  // Column distances of the window, indexed like the window itself
+  std::vector<int> column_dist(static_cast<size_t>(window_width) * window_height);
+  auto column_index = [x0, y0, window_width](int i, int j) {
+      return (j - y0) * window_width + (i - x0);
+    };
+
+  // Windows around small map edits are done before threads would even have
+  // started. Larger ones use the caller's pool, or one made for this update.
+  std::unique_ptr<nav2_util::WorkerPool> own_pool;
+  if (static_cast<long long>(window_width) * window_height < map_cspace_parallel_cells) {
+    pool = nullptr;
+  } else if (pool == nullptr) {
+    own_pool.reset(new nav2_util::WorkerPool());
+    pool = own_pool.get();
   }
-  ~CachedDistanceMap()
-  {
-    if (distances_) {
-      for (int i = 0; i <= cell_radius_ + 1; i++) {
-        delete[] distances_[i];
+  const unsigned int lanes = pool != nullptr ? pool->size() : 1;
+  auto run = [pool](int count, const nav2_util::WorkerPool::Task & task) {
+      if (pool != nullptr) {
+        pool->run(count, task, 16);
+      } else {
+        task(0, 0, count);
       }
-      delete[] distances_;
-    }
-  }
-  double ** distances_;
-  double scale_;
-  double max_dist_;
-  int cell_radius_;
-};
-
-
-bool operator<(const CellData & a, const CellData & b)
-{
-  return a.map_->cells[MAP_INDEX(a.map_, a.i_,
-         a.j_)].occ_dist > a.map_->cells[MAP_INDEX(b.map_, b.i_, b.j_)].occ_dist;
+    };
+
+  auto columns = [&](unsigned int, int begin, int end) {
+      for (int i = x0 + begin; i < x0 + end; i++) {
+        int d = cap;
+        for (int j = y0; j < y1; j++) {
+          d = map->occ_state[MAP_INDEX(map, i, j)] == +1 ? 0 : std::min(d + 1, cap);
+          column_dist[column_index(i, j)] = d;
+        }
+        d = cap;
+        for (int j = y1 - 1; j >= y0; j--) {
+          d = map->occ_state[MAP_INDEX(map, i, j)] == +1 ? 0 : std::min(d + 1, cap);
+          int & g = column_dist[column_index(i, j)];
+          g = std::min(g, d);
+        }
+      }
+    };
+  run(window_width, columns);
+
+  // Scratch space for the lower envelope of every lane: the positions of the
+  // parabolas and the boundaries between them
+  std::vector<std::vector<int>> lane_v(lanes, std::vector<int>(window_width));
+  std::vector<std::vector<double>> lane_z(lanes, std::vector<double>(window_width + 1));
+  const long long max_sq = static_cast<long long>(cell_radius) * cell_radius;
+
+  auto rows = [&](unsigned int lane, int begin, int end) {
+      int * v = lane_v[lane].data();
+      double * z = lane_z[lane].data();
+      for (int j = out_y0 + begin; j < out_y0 + end; j++) {
+        const int * g = column_dist.data() + column_index(x0, j);
+        float * out = map->occ_dist + MAP_INDEX(map, x0, j);
+
+        auto height = [g](int q) {
+            return static_cast<double>(g[q]) * g[q] + static_cast<double>(q) * q;
+          };
+
+        int k = 0;
+        v[0] = 0;
+        z[0] = -HUGE_VAL;
+        z[1] = HUGE_VAL;
+        for (int q = 1; q < window_width; q++) {
+          double s = (height(q) - height(v[k])) / (2.0 * (q - v[k]));
+          while (s <= z[k]) {
+            k--;
+            s = (height(q) - height(v[k])) / (2.0 * (q - v[k]));
+          }
+          k++;
+          v[k] = q;
+          z[k] = s;
+          z[k + 1] = HUGE_VAL;
+        }
+
+        k = 0;
+        for (int i = out_x0 - x0; i < out_x1 - x0; i++) {
+          while (z[k + 1] < i) {
+            k++;
+          }
+          long long di = i - v[k];
+          long long d_sq = di * di + static_cast<long long>(g[v[k]]) * g[v[k]];
+          out[i] = d_sq <= max_sq ? sqrt(static_cast<double>(d_sq)) * map->scale : max_occ_dist;
+        }
+      }
+    };
+  run(out_y1 - out_y0, rows);
 }
 
-CachedDistanceMap *
-get_distance_map(double scale, double max_dist)
+// Update the cspace distance values
+void map_update_cspace(map_t * map, double max_occ_dist)
 {
-  static CachedDistanceMap * cdm = NULL;
-
-  if (!cdm || (cdm->scale_ != scale) || (cdm->max_dist_ != max_dist)) {
-    if (cdm) {
-      delete cdm;
-    }
-    cdm = new CachedDistanceMap(scale, max_dist);
-  }
-
-  return cdm;
+  map_update_cspace(map, max_occ_dist, nullptr);
 }
 
-void enqueue(
-  map_t * map, int i, int j,
-  int src_i, int src_j,
-  std::priority_queue<CellData> & Q,
-  CachedDistanceMap * cdm,
-  unsigned char * marked)
+void map_update_cspace(map_t * map, double max_occ_dist, nav2_util::WorkerPool * pool)
 {
-  if (marked[MAP_INDEX(map, i, j)]) {
-    return;
-  }
+  const int size_x = map->size_x;
+  const int size_y = map->size_y;
 
-  int di = abs(i - src_i);
-  int dj = abs(j - src_j);
-  double distance = cdm->distances_[di][dj];
+  map->max_occ_dist = max_occ_dist;
+  map->occ_dist[size_x * size_y] = max_occ_dist;
 
-  if (distance > cdm->cell_radius_) {
+  if (size_x == 0 || size_y == 0) {
     return;
   }
 
-  map->cells[MAP_INDEX(map, i, j)].occ_dist = distance * map->scale;
-
-  CellData cell;
-  cell.map_ = map;
-  cell.i_ = i;
-  cell.j_ = j;
-  cell.src_i_ = src_i;
-  cell.src_j_ = src_j;
-
-  Q.push(cell);
-
-  marked[MAP_INDEX(map, i, j)] = 1;
+  map_cspace_window(map, pool, 0, 0, size_x, size_y, 0, 0, size_x, size_y);
 }
 
-// Update the cspace distance values
-void map_update_cspace(map_t * map, double max_occ_dist)
+// Update the cspace distance values after the occupancy states of the cells in
+// [min_i, max_i] x [min_j, max_j] changed. Only cells within max_occ_dist of the
+// region can see a different nearest obstacle, and their obstacles are in turn
+// within max_occ_dist of them, so the transform is run on a window twice that
+// margin around the region.
+void map_update_cspace_region(map_t * map, int min_i, int min_j, int max_i, int max_j)
 {
-  unsigned char * marked;
-  std::priority_queue<CellData> Q;
-
-  marked = new unsigned char[map->size_x * map->size_y];
-  memset(marked, 0, sizeof(unsigned char) * map->size_x * map->size_y);
-
-  map->max_occ_dist = max_occ_dist;
+  map_update_cspace_region(map, min_i, min_j, max_i, max_j, nullptr);
+}
 
-  CachedDistanceMap * cdm = get_distance_map(map->scale, map->max_occ_dist);
-
-  // Enqueue all the obstacle cells
-  CellData cell;
-  cell.map_ = map;
-  for (int i = 0; i < map->size_x; i++) {
-    cell.src_i_ = cell.i_ = i;
-    for (int j = 0; j < map->size_y; j++) {
-      if (map->cells[MAP_INDEX(map, i, j)].occ_state == +1) {
-        map->cells[MAP_INDEX(map, i, j)].occ_dist = 0.0;
-        cell.src_j_ = cell.j_ = j;
-        marked[MAP_INDEX(map, i, j)] = 1;
-        Q.push(cell);
-      } else {
-        map->cells[MAP_INDEX(map, i, j)].occ_dist = max_occ_dist;
-      }
-    }
+void map_update_cspace_region(
+  map_t * map, int min_i, int min_j, int max_i, int max_j, nav2_util::WorkerPool * pool)
+{
+  if (map->max_occ_dist < 0 || min_i > max_i || min_j > max_j) {
+    return;
   }
 
-  while (!Q.empty()) {
-    CellData current_cell = Q.top();
-    if (current_cell.i_ > 0) {
-      enqueue(map, current_cell.i_ - 1, current_cell.j_,
-        current_cell.src_i_, current_cell.src_j_,
-        Q, cdm, marked);
-    }
-    if (current_cell.j_ > 0) {
-      enqueue(map, current_cell.i_, current_cell.j_ - 1,
-        current_cell.src_i_, current_cell.src_j_,
-        Q, cdm, marked);
-    }
-    if (static_cast<int>(current_cell.i_) < map->size_x - 1) {
-      enqueue(map, current_cell.i_ + 1, current_cell.j_,
-        current_cell.src_i_, current_cell.src_j_,
-        Q, cdm, marked);
-    }
-    if (static_cast<int>(current_cell.j_) < map->size_y - 1) {
-      enqueue(map, current_cell.i_, current_cell.j_ + 1,
-        current_cell.src_i_, current_cell.src_j_,
-        Q, cdm, marked);
-    }
-
-    Q.pop();
+  const int margin = static_cast<int>(map->max_occ_dist / map->scale) + 1;
+
+  int out_x0 = std::max(min_i - margin, 0);
+  int out_y0 = std::max(min_j - margin, 0);
+  int out_x1 = std::min(max_i + margin + 1, map->size_x);
+  int out_y1 = std::min(max_j + margin + 1, map->size_y);
+  if (out_x0 >= out_x1 || out_y0 >= out_y1) {
+    return;
   }
 
-  delete[] marked;
+  map_cspace_window(map, pool,
+    std::max(out_x0 - margin, 0), std::max(out_y0 - margin, 0),
+    std::min(out_x1 + margin, map->size_x), std::min(out_y1 + margin, map->size_y),
+    out_x0, out_y0, out_x1, out_y1);
 }
@@ -87,16 +87,39 @@ double map_calc_range(map_t * map, double ox, double oy, double oa, double max_r
   }
 
   if (steep) {
-    if (!MAP_VALID(map, y, x) || map->cells[MAP_INDEX(map, y, x)].occ_state > -1) {
+    if (!MAP_VALID(map, y, x) || map->occ_state[MAP_INDEX(map, y, x)] > -1) {
       return sqrt((x - x0) * (x - x0) + (y - y0) * (y - y0)) * map->scale;
     }
   } else {
-    if (!MAP_VALID(map, x, y) || map->cells[MAP_INDEX(map, x, y)].occ_state > -1) {
+    if (!MAP_VALID(map, x, y) || map->occ_state[MAP_INDEX(map, x, y)] > -1) {
       return sqrt((x - x0) * (x - x0) + (y - y0) * (y - y0)) * map->scale;
     }
   }
 
   while (x != (x1 + xstep * 1)) {
+    // Every cell less than free_dist steps away along the line is known to be
+    // free, so jump over them, bounded by the end of the line. The jump
+    // applies the k error updates of Bresenham's algorithm at once.
+    if (map->free_dist && deltax > 0) {
+      int k;
+      if (steep) {
+        k = map->free_dist[MAP_INDEX(map, y, x)] - 1;
+      } else {
+        k = map->free_dist[MAP_INDEX(map, x, y)] - 1;
+      }
+      if (k > abs(x1 - x)) {
+        k = abs(x1 - x);
+      }
+      if (k > 0) {
+        int n;
+        x += k * xstep;
+        error += k * deltaerr;
+        n = (2 * error + deltax) / (2 * deltax);
+        y += n * ystep;
+        error -= n * deltax;
+      }
+    }
+
     x += xstep;
     error += deltaerr;
     if (2 * error >= deltax) {
@@ -105,14 +128,167 @@ double map_calc_range(map_t * map, double ox, double oy, double oa, double max_r
     }
 
     if (steep) {
-      if (!MAP_VALID(map, y, x) || map->cells[MAP_INDEX(map, y, x)].occ_state > -1) {
+      if (!MAP_VALID(map, y, x) || map->occ_state[MAP_INDEX(map, y, x)] > -1) {
         return sqrt((x - x0) * (x - x0) + (y - y0) * (y - y0)) * map->scale;
       }
     } else {
-      if (!MAP_VALID(map, x, y) || map->cells[MAP_INDEX(map, x, y)].occ_state > -1) {
+      if (!MAP_VALID(map, x, y) || map->occ_state[MAP_INDEX(map, x, y)] > -1) {
         return sqrt((x - x0) * (x - x0) + (y - y0) * (y - y0)) * map->scale;
       }
     }
   }
   return max_range;
 }
+
+
+// Compute the free space distances of the cells in [out_x0, out_x1) x
+// [out_y0, out_y1) from the occupancy states in the window [x0, x1) x [y0, y1)
+// around them, with the two-pass chessboard distance transform. The transform
+// runs on a copy of the window with a border of one cell, which is blocking
+// (0) where it lies outside the map and open (255) where it lies on the map,
+// so the distances are exact as long as the window reaches 255 cells beyond
+// the output, or the edge of the map. The chessboard distance never exceeds
+// the number of steps of a Bresenham line, which makes it safe to skip by.
+// Returns 0 on success.
+static int map_free_dist_window(
+  map_t * map, int x0, int y0, int x1, int y1,
+  int out_x0, int out_y0, int out_x1, int out_y1)
+{
+  int i, j, d, w, h;
+  uint8_t * dist;
+  uint8_t * cell;
+
+  w = x1 - x0 + 2;
+  h = y1 - y0 + 2;
+  dist = (uint8_t *) malloc((size_t) w * h);
+  if (dist == NULL) {
+    return -1;
+  }
+
+  // The border around the window, whose cell (i, j) of the map is at
+  // dist[(i - x0 + 1) + (j - y0 + 1) * w]
+  memset(dist, y0 == 0 ? 0 : 255, w);
+  memset(dist + (size_t) (h - 1) * w, y1 == map->size_y ? 0 : 255, w);
+  for (j = 1; j < h - 1; j++) {
+    dist[(size_t) j * w] = x0 == 0 ? 0 : 255;
+    dist[(size_t) j * w + w - 1] = x1 == map->size_x ? 0 : 255;
+  }
+
+  // Forward pass, from the neighbors below and to the left
+  for (j = y0; j < y1; j++) {
+    const int8_t * state = map->occ_state + MAP_INDEX(map, x0, j);
+    cell = dist + (size_t) (j - y0 + 1) * w + 1;
+    for (i = 0; i < x1 - x0; i++, cell++) {
+      if (state[i] > -1) {
+        *cell = 0;
+        continue;
+      }
+      d = cell[-1];
+      if (cell[-w - 1] < d) {
+        d = cell[-w - 1];
+      }
+      if (cell[-w] < d) {
+        d = cell[-w];
+      }
+      if (cell[-w + 1] < d) {
+        d = cell[-w + 1];
+      }
+      *cell = d < 255 ? d + 1 : 255;
+    }
+  }
+
+  // Backward pass, from the neighbors above and to the right
+  for (j = y1 - 1; j >= y0; j--) {
+    cell = dist + (size_t) (j - y0 + 1) * w + (x1 - x0);
+    for (i = x1 - x0 - 1; i >= 0; i--, cell--) {
+      d = *cell;
+      if (d <= 1) {
+        continue;
+      }
+      if (cell[1] + 1 < d) {
+        d = cell[1] + 1;
+      }
+      if (cell[w + 1] + 1 < d) {
+        d = cell[w + 1] + 1;
+      }
+      if (cell[w] + 1 < d) {
+        d = cell[w] + 1;
+      }
+      if (cell[w - 1] + 1 < d) {
+        d = cell[w - 1] + 1;
+      }
+      *cell = d;
+    }
+  }
+
+  for (j = out_y0; j < out_y1; j++) {
+    memcpy(map->free_dist + MAP_INDEX(map, out_x0, j),
+      dist + (size_t) (j - y0 + 1) * w + (out_x0 - x0 + 1), out_x1 - out_x0);
+  }
+
+  free(dist);
+  return 0;
+}
+
+
+// Drop the free space distances, so that map_calc_range() steps through
+// every cell again
+static int map_drop_free_dist(map_t * map)
+{
+  free(map->free_dist);
+  map->free_dist = NULL;
+  return -1;
+}
+
+
+// Update the free space distances used to accelerate map_calc_range()
+int map_update_free_dist(map_t * map)
+{
+  if (map->free_dist == NULL) {
+    map->free_dist = (uint8_t *) malloc((size_t) map->size_x * map->size_y);
+    if (map->free_dist == NULL) {
+      return -1;
+    }
+  }
+
+  if (map_free_dist_window(map, 0, 0, map->size_x, map->size_y,
+    0, 0, map->size_x, map->size_y) != 0)
+  {
+    return map_drop_free_dist(map);
+  }
+  return 0;
+}
+
+
+// Update the free space distances after the occupancy states of the cells in
+// [min_i, max_i] x [min_j, max_j] changed. A cell's distance only depends on
+// the blocking cells up to 255 cells away, so only the cells that close to
+// the region are recomputed, from a window as far again around them.
+int map_update_free_dist_region(map_t * map, int min_i, int min_j, int max_i, int max_j)
+{
+  const int margin = 255;
+  int out_x0, out_y0, out_x1, out_y1;
+
+  if (map->free_dist == NULL || min_i > max_i || min_j > max_j) {
+    return 0;
+  }
+
+  out_x0 = min_i - margin > 0 ? min_i - margin : 0;
+  out_y0 = min_j - margin > 0 ? min_j - margin : 0;
+  out_x1 = max_i + margin + 1 < map->size_x ? max_i + margin + 1 : map->size_x;
+  out_y1 = max_j + margin + 1 < map->size_y ? max_j + margin + 1 : map->size_y;
+  if (out_x0 >= out_x1 || out_y0 >= out_y1) {
+    return 0;
+  }
+
+  if (map_free_dist_window(map,
+    out_x0 - margin > 0 ? out_x0 - margin : 0,
+    out_y0 - margin > 0 ? out_y0 - margin : 0,
+    out_x1 + margin < map->size_x ? out_x1 + margin : map->size_x,
+    out_y1 + margin < map->size_y ? out_y1 + margin : map->size_y,
+    out_x0, out_y0, out_x1, out_y1) != 0)
+  {
+    return map_drop_free_dist(map);
+  }
+  return 0;
+}
@@ -43,7 +43,6 @@ int map_load_occ(map_t * map, const char * filename, double scale, int negate)
   int i, j;
   int ch, occ;
   int width, height, depth;
-  map_cell_t * cell;
 
   // Open file
   file = fopen(filename, "r");
@@ -73,11 +72,12 @@ int map_load_occ(map_t * map, const char * filename, double scale, int negate)
   }
 
   // Allocate space in the map
-  if (map->cells == NULL) {
+  if (map->occ_state == NULL) {
     map->scale = scale;
-    map->size_x = width;
-    map->size_y = height;
-    map->cells = calloc(width * height, sizeof(map->cells[0]));
+    if (map_alloc_cells(map, width, height) != 0) {
+      fclose(file);
+      return -1;
+    }
   } else {
     if (width != map->size_x || height != map->size_y) {
       // PLAYER_ERROR("map dimensions are inconsistent with prior map dimensions");
@@ -113,8 +113,7 @@ int map_load_occ(map_t * map, const char * filename, double scale, int negate)
       if (!MAP_VALID(map, i, j)) {
         continue;
       }
-      cell = map->cells + MAP_INDEX(map, i, j);
-      cell->occ_state = occ;
+      map->occ_state[MAP_INDEX(map, i, j)] = occ;
     }
   }
 
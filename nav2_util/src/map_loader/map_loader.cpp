@@ -30,6 +30,7 @@
 //  Author: Brian Gerkey
 
 #include "nav2_util/map_loader/map_loader.hpp"
+#include "nav2_util/map_loader/occupancy_conversion.hpp"
 #include <stdlib.h>
 #include <stdio.h>
 // We use SDL_image to load the image from disk
@@ -38,10 +39,6 @@
 #include <stdexcept>
 #include "tf2/LinearMath/Quaternion.h"
 
-
-// compute linear index for given map coords
-#define MAP_IDX(sx, i, j) ((sx) * (j) + (i))
-
 namespace map_loader
 {
 
@@ -52,17 +49,6 @@ nav_msgs::msg::OccupancyGrid loadMapFromFile(
 {
   SDL_Surface * img;
 
-  unsigned char * pixels;
-  unsigned char * p;
-  unsigned char value;
-  int rowstride, n_channels, avg_channels;
-  unsigned int i, j;
-  int k;
-  double occ;
-  int alpha;
-  int color_sum;
-  double color_avg;
-
   // Load the image using SDL.  If we get NULL back, the image load failed.
   if (!(img = IMG_Load(image_file_name.c_str()))) {
     std::string errmsg = std::string("failed to open image file \"") +
@@ -90,65 +76,11 @@ nav_msgs::msg::OccupancyGrid loadMapFromFile(
   // Allocate space to hold the data
   map.data.resize(map.info.width * map.info.height);
 
-  // Get values that we'll need to iterate through the pixels
-  rowstride = img->pitch;
-  n_channels = img->format->BytesPerPixel;
-
-  // NOTE: Trinary mode still overrides here to preserve existing behavior.
-  // Alpha will be averaged in with color channels when using trinary mode.
-  if (mode == TRINARY || !img->format->Amask) {
-    avg_channels = n_channels;
-  } else {
-    avg_channels = n_channels - 1;
-  }
-
-  // Copy pixel data into the map structure
-  pixels = (unsigned char *)(img->pixels);
-  for (j = 0; j < map.info.height; j++) {
-    for (i = 0; i < map.info.width; i++) {
-      // Compute mean of RGB for this pixel
-      p = pixels + j * rowstride + i * n_channels;
-      color_sum = 0;
-      for (k = 0; k < avg_channels; k++) {
-        color_sum += *(p + (k));
-      }
-      color_avg = color_sum / static_cast<double>(avg_channels);
-
-      if (n_channels == 1) {
-        alpha = 1;
-      } else {
-        alpha = *(p + n_channels - 1);
-      }
-      if (negate) {
-        color_avg = 255 - color_avg;
-      }
-      if (mode == RAW) {
-        value = color_avg;
-        map.data[MAP_IDX(map.info.width, i, map.info.height - j - 1)] = value;
-        continue;
-      }
-
-      // If negate is true, we consider blacker pixels free, and whiter
-      // pixels occupied.  Otherwise, it's vice versa.
-      occ = (255 - color_avg) / 255.0;
-
-      // Apply thresholds to RGB means to determine occupancy values for
-      // map.  Note that we invert the graphics-ordering of the pixels to
-      // produce a map with cell (0,0) in the lower-left corner.
-      if (occ > occupancy_threshold) {
-        value = +100;
-      } else if (occ < free_threshold) {
-        value = 0;
-      } else if (mode == TRINARY || alpha < 1.0) {
-        value = -1;
-      } else {
-        double ratio = (occ - free_threshold) / (occupancy_threshold - free_threshold);
-        value = 99 * ratio;
-      }
-
-      map.data[MAP_IDX(map.info.width, i, map.info.height - j - 1)] = value;
-    }
-  }
+  // Convert the pixels into the map structure
+  convertImageToOccupancy(
+    static_cast<unsigned char *>(img->pixels), img->w, img->h, img->pitch,
+    img->format->BytesPerPixel, img->format->Amask != 0, negate,
+    occupancy_threshold, free_threshold, mode, map.data.data());
   SDL_FreeSurface(img);
 
   return map;
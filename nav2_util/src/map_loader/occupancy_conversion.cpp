@@ -0,0 +1,140 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_util/map_loader/occupancy_conversion.hpp"
+
+#include <vector>
+
+#include "nav2_util/worker_pool.hpp"
+
+namespace map_loader
+{
+
+// The value of a pixel with the given mean color
+static int8_t occupancyValue(
+  double color_avg, bool transparent, bool negate, double occupancy_threshold,
+  double free_threshold, MapMode mode)
+{
+  unsigned char value;
+
+  if (negate) {
+    color_avg = 255 - color_avg;
+  }
+  if (mode == RAW) {
+    value = color_avg;
+    return value;
+  }
+
+  // If negate is true, we consider blacker pixels free, and whiter
+  // pixels occupied.  Otherwise, it's vice versa.
+  double occ = (255 - color_avg) / 255.0;
+
+  if (occ > occupancy_threshold) {
+    value = +100;
+  } else if (occ < free_threshold) {
+    value = 0;
+  } else if (mode == TRINARY || transparent) {
+    value = -1;
+  } else {
+    double ratio = (occ - free_threshold) / (occupancy_threshold - free_threshold);
+    value = 99 * ratio;
+  }
+  return value;
+}
+
+// Convert a row of a multi-channel image. The number of averaged channels is a
+// template parameter for the usual RGB and RGBA layouts, so that the sum is
+// unrolled; 0 uses the runtime count.
+template<int AVG_CHANNELS>
+static void convertRow(
+  const unsigned char * p, int width, int n_channels, int runtime_avg_channels,
+  const int8_t * opaque, const int8_t * transparent, int8_t * out)
+{
+  const int avg_channels = AVG_CHANNELS > 0 ? AVG_CHANNELS : runtime_avg_channels;
+  for (int i = 0; i < width; i++, p += n_channels) {
+    int color_sum = 0;
+    for (int k = 0; k < avg_channels; k++) {
+      color_sum += p[k];
+    }
+    out[i] = p[n_channels - 1] == 0 ? transparent[color_sum] : opaque[color_sum];
+  }
+}
+
+void convertImageToOccupancy(
+  const unsigned char * pixels, int width, int height, int rowstride, int n_channels,
+  bool has_alpha, bool negate, double occupancy_threshold, double free_threshold,
+  MapMode mode, int8_t * data)
+{
+  // NOTE: Trinary mode still overrides here to preserve existing behavior.
+  // Alpha will be averaged in with color channels when using trinary mode.
+  const int avg_channels = (mode == TRINARY || !has_alpha) ? n_channels : n_channels - 1;
+
+  // Values for every sum of the averaged channels, for opaque pixels and for
+  // pixels whose alpha is zero
+  const int sum_count = 255 * avg_channels + 1;
+  std::vector<int8_t> opaque(sum_count);
+  std::vector<int8_t> transparent(sum_count);
+  for (int sum = 0; sum < sum_count; sum++) {
+    const double color_avg = sum / static_cast<double>(avg_channels);
+    opaque[sum] = occupancyValue(
+      color_avg, false, negate, occupancy_threshold, free_threshold, mode);
+    transparent[sum] = occupancyValue(
+      color_avg, true, negate, occupancy_threshold, free_threshold, mode);
+  }
+
+  // Image rows go top to bottom, map rows bottom to top
+  auto output_row = [&](int j) {
+      return data + static_cast<size_t>(height - j - 1) * width;
+    };
+
+  if (n_channels == 1) {
+    // Grayscale pixels are always opaque and index the table directly. This is
+    // bound by memory bandwidth, so it stays on the calling thread.
+    const int8_t * table = opaque.data();
+    for (int j = 0; j < height; j++) {
+      const unsigned char * in = pixels + static_cast<size_t>(j) * rowstride;
+      int8_t * out = output_row(j);
+      for (int i = 0; i < width; i++) {
+        out[i] = table[in[i]];
+      }
+    }
+    return;
+  }
+
+  auto rows = [&](unsigned int, int begin, int end) {
+      for (int j = begin; j < end; j++) {
+        const unsigned char * in = pixels + static_cast<size_t>(j) * rowstride;
+        int8_t * out = output_row(j);
+        switch (avg_channels) {
+          case 3:
+            convertRow<3>(
+              in, width, n_channels, avg_channels, opaque.data(), transparent.data(), out);
+            break;
+          case 4:
+            convertRow<4>(
+              in, width, n_channels, avg_channels, opaque.data(), transparent.data(), out);
+            break;
+          default:
+            convertRow<0>(
+              in, width, n_channels, avg_channels, opaque.data(), transparent.data(), out);
+            break;
+        }
+      }
+    };
+
+  nav2_util::WorkerPool pool;
+  pool.run(height, rows, 64);
+}
+
+}  // namespace map_loader
@@ -30,6 +30,23 @@
 namespace nav2_util
 {
 
+// Same as angleutils::angle_diff(a, b) for an a that is already normalized.
+// The noise b is almost always within [-pi, pi], so it is only normalized
+// when it has to be, which saves the trigonometry in the common case.
+static inline double
+angle_diff_normalized(double a, double b)
+{
+  if (b > M_PI || b < -M_PI) {
+    b = angleutils::normalize(b);
+  }
+  double d1 = a - b;
+  double d2 = 2 * M_PI - fabs(d1);
+  if (d1 > 0) {
+    d2 *= -1.0;
+  }
+  return fabs(d1) < fabs(d2) ? d1 : d2;
+}
+
 DifferentialMotionModel::DifferentialMotionModel(
   double alpha1, double alpha2, double alpha3,
   double alpha4)
@@ -78,27 +95,37 @@ DifferentialMotionModel::odometryUpdate(
   delta_rot2_noise = std::min(fabs(angleutils::angle_diff(delta_rot2, 0.0)),
       fabs(angleutils::angle_diff(delta_rot2, M_PI)));
 
-  for (int i = 0; i < set->sample_count; i++) {
-    pf_sample_t * sample = set->samples + i;
+  // Standard deviations of the noise on each component of the motion
+  double rot1_stddev = sqrt(alpha1_ * delta_rot1_noise * delta_rot1_noise +
+      alpha2_ * delta_trans * delta_trans);
+  double trans_stddev = sqrt(alpha3_ * delta_trans * delta_trans +
+      alpha4_ * delta_rot1_noise * delta_rot1_noise +
+      alpha4_ * delta_rot2_noise * delta_rot2_noise);
+  double rot2_stddev = sqrt(alpha1_ * delta_rot2_noise * delta_rot2_noise +
+      alpha2_ * delta_trans * delta_trans);
+
+  // Draw the noise of every sample at once, one array per component
+  int n = set->sample_count;
+  const double * rot1_noise = drawNoise(n, 3);
+  const double * trans_noise = rot1_noise + n;
+  const double * rot2_noise = trans_noise + n;
 
+  // delta_rot1 and delta_rot2 come out of angle_diff, so they are normalized
+  double * x = set->x;
+  double * y = set->y;
+  double * theta = set->theta;
+  for (int i = 0; i < n; i++) {
     // Sample pose differences
-    delta_rot1_hat = angleutils::angle_diff(delta_rot1,
-        pf_ran_gaussian(sqrt(alpha1_ * delta_rot1_noise * delta_rot1_noise +
-        alpha2_ * delta_trans * delta_trans)));
-    delta_trans_hat = delta_trans -
-      pf_ran_gaussian(sqrt(alpha3_ * delta_trans * delta_trans +
-        alpha4_ * delta_rot1_noise * delta_rot1_noise +
-        alpha4_ * delta_rot2_noise * delta_rot2_noise));
-    delta_rot2_hat = angleutils::angle_diff(delta_rot2,
-        pf_ran_gaussian(sqrt(alpha1_ * delta_rot2_noise * delta_rot2_noise +
-        alpha2_ * delta_trans * delta_trans)));
-
-    // Apply sampled update to particle pose
-    sample->pose.v[0] += delta_trans_hat *
-      cos(sample->pose.v[2] + delta_rot1_hat);
-    sample->pose.v[1] += delta_trans_hat *
-      sin(sample->pose.v[2] + delta_rot1_hat);
-    sample->pose.v[2] += delta_rot1_hat + delta_rot2_hat;
+    delta_rot1_hat = angle_diff_normalized(delta_rot1, rot1_stddev * rot1_noise[i]);
+    delta_trans_hat = delta_trans - trans_stddev * trans_noise[i];
+    delta_rot2_hat = angle_diff_normalized(delta_rot2, rot2_stddev * rot2_noise[i]);
+
+    // Apply sampled update to particle pose. The heading is read once, since
+    // the compiler can't tell that the stores to x and y leave it unchanged.
+    double heading = theta[i];
+    x[i] += delta_trans_hat * cos(heading + delta_rot1_hat);
+    y[i] += delta_trans_hat * sin(heading + delta_rot1_hat);
+    theta[i] = heading + delta_rot1_hat + delta_rot2_hat;
   }
 }
 
@@ -64,24 +64,34 @@ OmniMotionModel::odometryUpdate(pf_t * pf, const pf_vector_t & pose, const pf_ve
   double strafe_hat_stddev = sqrt(alpha4_ * (delta_rot * delta_rot) +
       alpha5_ * (delta_trans * delta_trans) );
 
-  for (int i = 0; i < set->sample_count; i++) {
-    pf_sample_t * sample = set->samples + i;
+  // The bearing of the motion relative to the heading is the same for every sample
+  double relative_bearing = angleutils::angle_diff(atan2(delta.v[1], delta.v[0]),
+      old_pose.v[2]);
 
-    delta_bearing = angleutils::angle_diff(atan2(delta.v[1], delta.v[0]),
-        old_pose.v[2]) + sample->pose.v[2];
+  // Draw the noise of every sample at once, one array per component
+  int n = set->sample_count;
+  const double * trans_noise = drawNoise(n, 3);
+  const double * rot_noise = trans_noise + n;
+  const double * strafe_noise = rot_noise + n;
+
+  double * x = set->x;
+  double * y = set->y;
+  double * theta = set->theta;
+  for (int i = 0; i < n; i++) {
+    delta_bearing = relative_bearing + theta[i];
     double cs_bearing = cos(delta_bearing);
     double sn_bearing = sin(delta_bearing);
 
     // Sample pose differences
-    delta_trans_hat = delta_trans + pf_ran_gaussian(trans_hat_stddev);
-    delta_rot_hat = delta_rot + pf_ran_gaussian(rot_hat_stddev);
-    delta_strafe_hat = 0 + pf_ran_gaussian(strafe_hat_stddev);
+    delta_trans_hat = delta_trans + trans_hat_stddev * trans_noise[i];
+    delta_rot_hat = delta_rot + rot_hat_stddev * rot_noise[i];
+    delta_strafe_hat = 0 + strafe_hat_stddev * strafe_noise[i];
     // Apply sampled update to particle pose
-    sample->pose.v[0] += (delta_trans_hat * cs_bearing +
+    x[i] += (delta_trans_hat * cs_bearing +
       delta_strafe_hat * sn_bearing);
-    sample->pose.v[1] += (delta_trans_hat * sn_bearing -
+    y[i] += (delta_trans_hat * sn_bearing -
       delta_strafe_hat * cs_bearing);
-    sample->pose.v[2] += delta_rot_hat;
+    theta[i] += delta_rot_hat;
   }
 }
 
@@ -33,12 +33,15 @@
 
 #include "nav2_util/pf/pf.hpp"
 #include "nav2_util/pf/pf_pdf.hpp"
-#include "nav2_util/pf/pf_kdtree.hpp"
+#include "nav2_util/pf/pf_hashgrid.hpp"
 
 
-// Compute the required number of samples, given that there are k bins
-// with samples in them.
-static int pf_resample_limit(pf_t * pf, int k);
+// Normalize the weights of a set, given their sum, and fold their mean, times
+// scale, into the running averages of the likelihood
+static void pf_normalize_weights(pf_t * pf, pf_sample_set_t * set, double total, double scale);
+
+// Allocate the sample arrays of a set for up to max_samples samples
+static void pf_alloc_samples(pf_sample_set_t * set, int max_samples);
 
 
 // Create a new filter
@@ -50,7 +53,6 @@ pf_t * pf_alloc(
   int i, j;
   pf_t * pf;
   pf_sample_set_t * set;
-  pf_sample_t * sample;
 
   srand48(time(NULL));
 
@@ -76,18 +78,18 @@ pf_t * pf_alloc(
     set = pf->sets + j;
 
     set->sample_count = max_samples;
-    set->samples = calloc(max_samples, sizeof(pf_sample_t));
+    pf_alloc_samples(set, max_samples);
 
     for (i = 0; i < set->sample_count; i++) {
-      sample = set->samples + i;
-      sample->pose.v[0] = 0.0;
-      sample->pose.v[1] = 0.0;
-      sample->pose.v[2] = 0.0;
-      sample->weight = 1.0 / max_samples;
+      set->x[i] = 0.0;
+      set->y[i] = 0.0;
+      set->theta[i] = 0.0;
+      set->weight[i] = 1.0 / max_samples;
     }
 
-    // HACK: is 3 times max_samples enough?
-    set->kdtree = pf_kdtree_alloc(3 * max_samples);
+    // A set can't occupy more bins than it has samples
+    set->histogram = pf_hashgrid_alloc(max_samples);
+    set->sample_bins = calloc(max_samples, sizeof(int));
 
     set->cluster_count = 0;
     set->cluster_max_count = max_samples;
@@ -103,12 +105,42 @@ pf_t * pf_alloc(
   pf->alpha_slow = alpha_slow;
   pf->alpha_fast = alpha_fast;
 
+  // The bin count of a set can't exceed its sample count
+  pf->limit_cache = calloc(max_samples + 1, sizeof(int));
+  pf->limit_cache_err = 0.0;
+  pf->limit_cache_z = 0.0;
+
+  pf->alias_prob = calloc(max_samples, sizeof(double));
+  pf->alias_index = calloc(max_samples, sizeof(int));
+  pf->alias_work = calloc(max_samples, sizeof(int));
+
+  pf->prior_weights = calloc(max_samples, sizeof(double));
+  pf->log_weights = calloc(max_samples, sizeof(double));
+
   // set converged to 0
   pf_init_converged(pf);
 
   return pf;
 }
 
+// Allocate the sample arrays of a set. The arrays share one block, each padded
+// to a multiple of 64 bytes so that all of them start on a cache line.
+void pf_alloc_samples(pf_sample_set_t * set, int max_samples)
+{
+  size_t stride;
+  void * block;
+
+  stride = ((size_t) max_samples + 7) & ~(size_t) 7;
+  if (posix_memalign(&block, 64, 4 * stride * sizeof(double)) != 0) {
+    block = NULL;
+  }
+
+  set->x = (double *) block;
+  set->y = set->x + stride;
+  set->theta = set->y + stride;
+  set->weight = set->theta + stride;
+}
+
 // Free an existing filter
 void pf_free(pf_t * pf)
 {
@@ -116,9 +148,16 @@ void pf_free(pf_t * pf)
 
   for (i = 0; i < 2; i++) {
     free(pf->sets[i].clusters);
-    pf_kdtree_free(pf->sets[i].kdtree);
-    free(pf->sets[i].samples);
+    pf_hashgrid_free(pf->sets[i].histogram);
+    free(pf->sets[i].sample_bins);
+    free(pf->sets[i].x);
   }
+  free(pf->limit_cache);
+  free(pf->alias_prob);
+  free(pf->alias_index);
+  free(pf->alias_work);
+  free(pf->prior_weights);
+  free(pf->log_weights);
   free(pf);
 }
 
@@ -127,13 +166,13 @@ void pf_init(pf_t * pf, pf_vector_t mean, pf_matrix_t cov)
 {
   int i;
   pf_sample_set_t * set;
-  pf_sample_t * sample;
+  pf_vector_t pose;
   pf_pdf_gaussian_t * pdf;
 
   set = pf->sets + pf->current_set;
 
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set->kdtree);
+  // Create the histogram for adaptive sampling
+  pf_hashgrid_clear(set->histogram);
 
   set->sample_count = pf->max_samples;
 
@@ -141,12 +180,12 @@ void pf_init(pf_t * pf, pf_vector_t mean, pf_matrix_t cov)
 
   // Compute the new sample poses
   for (i = 0; i < set->sample_count; i++) {
-    sample = set->samples + i;
-    sample->weight = 1.0 / pf->max_samples;
-    sample->pose = pf_pdf_gaussian_sample(pdf);
+    pose = pf_pdf_gaussian_sample(pdf);
+    pf_sample_set_pose(set, i, pose);
+    set->weight[i] = 1.0 / pf->max_samples;
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    set->sample_bins[i] = pf_hashgrid_insert(set->histogram, pose, set->weight[i]);
   }
 
   pf->w_slow = pf->w_fast = 0.0;
@@ -166,23 +205,23 @@ void pf_init_model(pf_t * pf, pf_init_model_fn_t init_fn, void * init_data)
 {
   int i;
   pf_sample_set_t * set;
-  pf_sample_t * sample;
+  pf_vector_t pose;
 
   set = pf->sets + pf->current_set;
 
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set->kdtree);
+  // Create the histogram for adaptive sampling
+  pf_hashgrid_clear(set->histogram);
 
   set->sample_count = pf->max_samples;
 
   // Compute the new sample poses
   for (i = 0; i < set->sample_count; i++) {
-    sample = set->samples + i;
-    sample->weight = 1.0 / pf->max_samples;
-    sample->pose = (*init_fn)(init_data);
+    pose = (*init_fn)(init_data);
+    pf_sample_set_pose(set, i, pose);
+    set->weight[i] = 1.0 / pf->max_samples;
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    set->sample_bins[i] = pf_hashgrid_insert(set->histogram, pose, set->weight[i]);
   }
 
   pf->w_slow = pf->w_fast = 0.0;
@@ -206,24 +245,20 @@ int pf_update_converged(pf_t * pf)
 {
   int i;
   pf_sample_set_t * set;
-  pf_sample_t * sample;
 
   set = pf->sets + pf->current_set;
   double mean_x = 0, mean_y = 0;
 
   for (i = 0; i < set->sample_count; i++) {
-    sample = set->samples + i;
-
-    mean_x += sample->pose.v[0];
-    mean_y += sample->pose.v[1];
+    mean_x += set->x[i];
+    mean_y += set->y[i];
   }
   mean_x /= set->sample_count;
   mean_y /= set->sample_count;
 
   for (i = 0; i < set->sample_count; i++) {
-    sample = set->samples + i;
-    if (fabs(sample->pose.v[0] - mean_x) > pf->dist_threshold ||
-      fabs(sample->pose.v[1] - mean_y) > pf->dist_threshold)
+    if (fabs(set->x[i] - mean_x) > pf->dist_threshold ||
+      fabs(set->y[i] - mean_y) > pf->dist_threshold)
     {
       set->converged = 0;
       pf->converged = 0;
@@ -248,9 +283,7 @@ void pf_update_action(pf_t * pf, pf_action_model_fn_t action_fn, void * action_d
 // Update the filter with some new sensor observation
 void pf_update_sensor(pf_t * pf, pf_sensor_model_fn_t sensor_fn, void * sensor_data)
 {
-  int i;
   pf_sample_set_t * set;
-  pf_sample_t * sample;
   double total;
 
   set = pf->sets + pf->current_set;
@@ -258,16 +291,77 @@ void pf_update_sensor(pf_t * pf, pf_sensor_model_fn_t sensor_fn, void * sensor_d
   // Compute the sample weights
   total = (*sensor_fn)(sensor_data, set);
 
+  pf_normalize_weights(pf, set, total, 1.0);
+}
+
+
+// Update the filter with several sensor observations at once. Each sensor
+// weighs the samples starting from unit weights, and the logs of its weights
+// are summed up per sample; the prior weights are then scaled by the joint
+// likelihoods, relative to the largest one so they can't all underflow.
+void pf_update_sensors(
+  pf_t * pf, int sensor_count, pf_sensor_model_fn_t sensor_fns[], void * sensor_data[])
+{
+  int i, k;
+  pf_sample_set_t * set;
+  double total, max_log_weight;
+
+  set = pf->sets + pf->current_set;
+
+  for (i = 0; i < set->sample_count; i++) {
+    pf->prior_weights[i] = set->weight[i];
+    pf->log_weights[i] = 0.0;
+  }
+
+  for (k = 0; k < sensor_count; k++) {
+    for (i = 0; i < set->sample_count; i++) {
+      set->weight[i] = 1.0;
+    }
+
+    (*sensor_fns[k])(sensor_data[k], set);
+
+    for (i = 0; i < set->sample_count; i++) {
+      pf->log_weights[i] += log(set->weight[i]);
+    }
+  }
+
+  max_log_weight = -INFINITY;
+  for (i = 0; i < set->sample_count; i++) {
+    if (pf->prior_weights[i] > 0.0 && pf->log_weights[i] > max_log_weight) {
+      max_log_weight = pf->log_weights[i];
+    }
+  }
+
+  // All the samples were ruled out
+  if (max_log_weight == -INFINITY) {
+    pf_normalize_weights(pf, set, 0.0, 1.0);
+    return;
+  }
+
+  total = 0.0;
+  for (i = 0; i < set->sample_count; i++) {
+    set->weight[i] = pf->prior_weights[i] * exp(pf->log_weights[i] - max_log_weight);
+    total += set->weight[i];
+  }
+
+  pf_normalize_weights(pf, set, total, exp(max_log_weight));
+}
+
+
+// Normalize the weights of a set and update the running averages
+void pf_normalize_weights(pf_t * pf, pf_sample_set_t * set, double total, double scale)
+{
+  int i;
+
   if (total > 0.0) {
     // Normalize weights
     double w_avg = 0.0;
     for (i = 0; i < set->sample_count; i++) {
-      sample = set->samples + i;
-      w_avg += sample->weight;
-      sample->weight /= total;
+      w_avg += set->weight[i];
+      set->weight[i] /= total;
     }
     // Update running averages of likelihood of samples (Prob Rob p258)
-    w_avg /= set->sample_count;
+    w_avg = w_avg / set->sample_count * scale;
     if (pf->w_slow == 0.0) {
       pf->w_slow = w_avg;
     } else {
@@ -281,8 +375,7 @@ void pf_update_sensor(pf_t * pf, pf_sensor_model_fn_t sensor_fn, void * sensor_d
   } else {
     // Handle zero total
     for (i = 0; i < set->sample_count; i++) {
-      sample = set->samples + i;
-      sample->weight = 1.0 / set->sample_count;
+      set->weight[i] = 1.0 / set->sample_count;
     }
   }
 }
@@ -291,32 +384,25 @@ void pf_update_sensor(pf_t * pf, pf_sensor_model_fn_t sensor_fn, void * sensor_d
 // Resample the distribution
 void pf_update_resample(pf_t * pf)
 {
-  int i;
+  int i, b;
   double total;
   pf_sample_set_t * set_a, * set_b;
-  pf_sample_t * sample_a, * sample_b;
-
-  // double r,c,U;
-  // int m;
-  // double count_inv;
-  double * c;
+  pf_vector_t pose;
 
   double w_diff;
 
   set_a = pf->sets + pf->current_set;
   set_b = pf->sets + (pf->current_set + 1) % 2;
 
-  // Build up cumulative probability table for resampling.
-  // TODO(?): Replace this with a more efficient procedure
-  // (e.g., http://www.network-theory.co.uk/docs/gslref/GeneralDiscreteDistributions.html)
-  c = (double *)malloc(sizeof(double) * (set_a->sample_count + 1));
-  c[0] = 0.0;
-  for (i = 0; i < set_a->sample_count; i++) {
-    c[i + 1] = c[i] + set_a->samples[i].weight;
-  }
+  // Build up the alias table for resampling. Unlike the low-variance resampler
+  // it keeps the draws independent, which is what KLD adaptive sampling needs,
+  // while making each draw O(1).
+  pf_build_alias_table(pf, set_a);
+
+  pf_update_limit_cache(pf);
 
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set_b->kdtree);
+  // Create the histogram for adaptive sampling
+  pf_hashgrid_clear(set_b->histogram);
 
   // Draw samples from set a to create set b.
   total = 0;
@@ -328,72 +414,29 @@ void pf_update_resample(pf_t * pf)
   }
   // printf("w_diff: %9.6f\n", w_diff);
 
-  // Can't (easily) combine low-variance sampler with KLD adaptive
-  // sampling, so we'll take the more traditional route.
-  /*
-  // Low-variance resampler, taken from Probabilistic Robotics, p110
-  count_inv = 1.0/set_a->sample_count;
-  r = drand48() * count_inv;
-  c = set_a->samples[0].weight;
-  i = 0;
-  m = 0;
-  */
   while (set_b->sample_count < pf->max_samples) {
-    sample_b = set_b->samples + set_b->sample_count++;
+    b = set_b->sample_count++;
 
     if (drand48() < w_diff) {
-      sample_b->pose = (pf->random_pose_fn)(pf->random_pose_data);
+      pose = (pf->random_pose_fn)(pf->random_pose_data);
     } else {
-      // Can't (easily) combine low-variance sampler with KLD adaptive
-      // sampling, so we'll take the more traditional route.
-      /*
-      // Low-variance resampler, taken from Probabilistic Robotics, p110
-      U = r + m * count_inv;
-      while(U>c)
-      {
-        i++;
-        // Handle wrap-around by resetting counters and picking a new random
-        // number
-        if(i >= set_a->sample_count)
-        {
-          r = drand48() * count_inv;
-          c = set_a->samples[0].weight;
-          i = 0;
-          m = 0;
-          U = r + m * count_inv;
-          continue;
-        }
-        c += set_a->samples[i].weight;
-      }
-      m++;
-      */
-
-      // Naive discrete event sampler
-      double r;
-      r = drand48();
-      for (i = 0; i < set_a->sample_count; i++) {
-        if ((c[i] <= r) && (r < c[i + 1])) {
-          break;
-        }
-      }
-      assert(i < set_a->sample_count);
-
-      sample_a = set_a->samples + i;
+      i = pf_draw_alias_sample(pf, set_a->sample_count);
 
-      assert(sample_a->weight > 0);
+      assert(set_a->weight[i] > 0);
 
       // Add sample to list
-      sample_b->pose = sample_a->pose;
+      pose = pf_sample_pose(set_a, i);
     }
 
-    sample_b->weight = 1.0;
-    total += sample_b->weight;
+    pf_sample_set_pose(set_b, b, pose);
+    set_b->weight[b] = 1.0;
+    total += set_b->weight[b];
 
     // Add sample to histogram
-    pf_kdtree_insert(set_b->kdtree, sample_b->pose, sample_b->weight);
+    set_b->sample_bins[b] = pf_hashgrid_insert(set_b->histogram, pose, set_b->weight[b]);
 
     // See if we have enough samples yet
-    if (set_b->sample_count > pf_resample_limit(pf, set_b->kdtree->leaf_count)) {
+    if (set_b->sample_count > pf->limit_cache[set_b->histogram->bin_count]) {
       break;
     }
   }
@@ -407,8 +450,7 @@ void pf_update_resample(pf_t * pf)
 
   // Normalize weights
   for (i = 0; i < set_b->sample_count; i++) {
-    sample_b = set_b->samples + i;
-    sample_b->weight /= total;
+    set_b->weight[i] /= total;
   }
 
   // Re-compute cluster statistics
@@ -418,8 +460,85 @@ void pf_update_resample(pf_t * pf)
   pf->current_set = (pf->current_set + 1) % 2;
 
   pf_update_converged(pf);
+}
+
+
+// Build the alias table for the weights of the given set (Vose, "A linear
+// algorithm for generating random numbers with a given distribution").
+// Every slot i keeps its own sample with probability alias_prob[i] and
+// otherwise hands over to sample alias_index[i].
+void pf_build_alias_table(pf_t * pf, pf_sample_set_t * set)
+{
+  int i, n, small, large, s, l;
+  double total;
+  double * prob;
+
+  n = set->sample_count;
+  prob = pf->alias_prob;
+
+  total = 0.0;
+  for (i = 0; i < n; i++) {
+    total += set->weight[i];
+  }
+
+  // Scale the weights so that they average to one, and sort the slots into
+  // under-full ones (stacked from the front of the work list) and over-full
+  // ones (stacked from the back)
+  small = 0;
+  large = n;
+  for (i = 0; i < n; i++) {
+    prob[i] = set->weight[i] * n / total;
+    pf->alias_index[i] = i;
+    if (prob[i] < 1.0) {
+      pf->alias_work[small++] = i;
+    } else {
+      pf->alias_work[--large] = i;
+    }
+  }
+
+  // Top up every under-full slot with the excess of an over-full one
+  while (small > 0 && large < n) {
+    s = pf->alias_work[--small];
+    l = pf->alias_work[large++];
+
+    pf->alias_index[s] = l;
+    prob[l] = (prob[l] + prob[s]) - 1.0;
 
-  free(c);
+    if (prob[l] < 1.0) {
+      pf->alias_work[small++] = l;
+    } else {
+      pf->alias_work[--large] = l;
+    }
+  }
+
+  // Whatever is left is full, up to rounding errors
+  while (large < n) {
+    prob[pf->alias_work[large++]] = 1.0;
+  }
+  while (small > 0) {
+    prob[pf->alias_work[--small]] = 1.0;
+  }
+}
+
+
+// Draw the index of a sample from the alias table of a set of n samples
+int pf_draw_alias_sample(pf_t * pf, int n)
+{
+  double u;
+  int i;
+
+  // Use the integer part of a single draw to pick the slot and the
+  // fractional part to choose between the slot and its alias
+  u = drand48() * n;
+  i = (int) u;
+  if (i >= n) {
+    i = n - 1;
+  }
+
+  if (u - i < pf->alias_prob[i]) {
+    return i;
+  }
+  return pf->alias_index[i];
 }
 
 
@@ -452,31 +571,53 @@ int pf_resample_limit(pf_t * pf, int k)
 }
 
 
-// Re-compute the cluster statistics for a sample set
+// Make sure the table of pf_resample_limit() values matches the population
+// size parameters
+void pf_update_limit_cache(pf_t * pf)
+{
+  int k;
+
+  if (pf->limit_cache_err == pf->pop_err && pf->limit_cache_z == pf->pop_z) {
+    return;
+  }
+
+  for (k = 0; k <= pf->max_samples; k++) {
+    pf->limit_cache[k] = pf_resample_limit(pf, k);
+  }
+  pf->limit_cache_err = pf->pop_err;
+  pf->limit_cache_z = pf->pop_z;
+}
+
+
+// Re-compute the cluster statistics for a sample set. The cluster of every
+// sample is read from its cached histogram bin, so this takes one pass over the
+// samples to accumulate the cluster sums and one over the clusters to normalize
+// them; the overall filter sums are the totals of the cluster sums.
 void pf_cluster_stats(pf_t * pf, pf_sample_set_t * set)
 {
-  (void)pf;
-  int i, j, k, cidx;
-  pf_sample_t * sample;
+  int i, j, k, cidx, cluster_count;
   pf_cluster_t * cluster;
+  const pf_hashgrid_bin_t * bins;
 
   // Workspace
   double m[4], c[2][2];
-  size_t count;
-  double weight;
+  double weight, w, x, y, cos_a, sin_a;
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
 
   // Cluster the samples
-  pf_kdtree_cluster(set->kdtree);
+  cluster_count = pf_hashgrid_cluster(set->histogram);
+  if (cluster_count > set->cluster_max_count) {
+    cluster_count = set->cluster_max_count;
+  }
+  set->cluster_count = cluster_count;
 
   // Initialize cluster stats
-  set->cluster_count = 0;
-
-  for (i = 0; i < set->cluster_max_count; i++) {
+  for (i = 0; i < cluster_count; i++) {
     cluster = set->clusters + i;
     cluster->count = 0;
     cluster->weight = 0;
-    cluster->mean = pf_vector_zero();
-    cluster->cov = pf_matrix_zero();
 
     for (j = 0; j < 4; j++) {
       cluster->m[j] = 0.0;
@@ -488,8 +629,42 @@ void pf_cluster_stats(pf_t * pf, pf_sample_set_t * set)
     }
   }
 
+  // Compute cluster stats
+  bins = set->histogram->bins;
+  for (i = 0; i < set->sample_count; i++) {
+    // Get the cluster label for this sample
+    cidx = bins[set->sample_bins[i]].cluster;
+    if (cidx >= cluster_count) {
+      continue;
+    }
+
+    cluster = set->clusters + cidx;
+
+    // Read the sample before updating the cluster, whose sums the compiler
+    // can't tell apart from the sample arrays
+    w = set->weight[i];
+    x = set->x[i];
+    y = set->y[i];
+    cos_a = cos(set->theta[i]);
+    sin_a = sin(set->theta[i]);
+
+    cluster->count += 1;
+    cluster->weight += w;
+
+    // Compute mean
+    cluster->m[0] += w * x;
+    cluster->m[1] += w * y;
+    cluster->m[2] += w * cos_a;
+    cluster->m[3] += w * sin_a;
+
+    // Compute covariance in linear components
+    cluster->c[0][0] += w * x * x;
+    cluster->c[0][1] += w * x * y;
+    cluster->c[1][0] += w * y * x;
+    cluster->c[1][1] += w * y * y;
+  }
+
   // Initialize overall filter stats
-  count = 0;
   weight = 0.0;
   set->mean = pf_vector_zero();
   set->cov = pf_matrix_zero();
@@ -502,53 +677,19 @@ void pf_cluster_stats(pf_t * pf, pf_sample_set_t * set)
     }
   }
 
-  // Compute cluster stats
-  for (i = 0; i < set->sample_count; i++) {
-    sample = set->samples + i;
-
-    // printf("%d %f %f %f\n", i, sample->pose.v[0], sample->pose.v[1], sample->pose.v[2]);
+  // Normalize
+  for (i = 0; i < cluster_count; i++) {
+    cluster = set->clusters + i;
 
-    // Get the cluster label for this sample
-    cidx = pf_kdtree_get_cluster(set->kdtree, sample->pose);
-    assert(cidx >= 0);
-    if (cidx >= set->cluster_max_count) {
-      continue;
-    }
-    if (cidx + 1 > set->cluster_count) {
-      set->cluster_count = cidx + 1;
+    weight += cluster->weight;
+    for (j = 0; j < 4; j++) {
+      m[j] += cluster->m[j];
     }
-
-    cluster = set->clusters + cidx;
-
-    cluster->count += 1;
-    cluster->weight += sample->weight;
-
-    count += 1;
-    weight += sample->weight;
-
-    // Compute mean
-    cluster->m[0] += sample->weight * sample->pose.v[0];
-    cluster->m[1] += sample->weight * sample->pose.v[1];
-    cluster->m[2] += sample->weight * cos(sample->pose.v[2]);
-    cluster->m[3] += sample->weight * sin(sample->pose.v[2]);
-
-    m[0] += sample->weight * sample->pose.v[0];
-    m[1] += sample->weight * sample->pose.v[1];
-    m[2] += sample->weight * cos(sample->pose.v[2]);
-    m[3] += sample->weight * sin(sample->pose.v[2]);
-
-    // Compute covariance in linear components
     for (j = 0; j < 2; j++) {
       for (k = 0; k < 2; k++) {
-        cluster->c[j][k] += sample->weight * sample->pose.v[j] * sample->pose.v[k];
-        c[j][k] += sample->weight * sample->pose.v[j] * sample->pose.v[k];
+        c[j][k] += cluster->c[j][k];
       }
     }
-  }
-
-  // Normalize
-  for (i = 0; i < set->cluster_count; i++) {
-    cluster = set->clusters + i;
 
     cluster->mean.v[0] = cluster->m[0] / cluster->weight;
     cluster->mean.v[1] = cluster->m[1] / cluster->weight;
@@ -589,6 +730,9 @@ void pf_cluster_stats(pf_t * pf, pf_sample_set_t * set)
   // Covariance in angular components; I think this is the correct
   // formula for circular statistics.
   set->cov.m[2][2] = -2 * log(sqrt(m[2] * m[2] + m[3] * m[3]));
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  pf->cluster_stats_time = (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
 }
 
 
@@ -598,7 +742,6 @@ void pf_get_cep_stats(pf_t * pf, pf_vector_t * mean, double * var)
   int i;
   double mn, mx, my, mrr;
   pf_sample_set_t * set;
-  pf_sample_t * sample;
 
   set = pf->sets + pf->current_set;
 
@@ -608,13 +751,11 @@ void pf_get_cep_stats(pf_t * pf, pf_vector_t * mean, double * var)
   mrr = 0.0;
 
   for (i = 0; i < set->sample_count; i++) {
-    sample = set->samples + i;
-
-    mn += sample->weight;
-    mx += sample->weight * sample->pose.v[0];
-    my += sample->weight * sample->pose.v[1];
-    mrr += sample->weight * sample->pose.v[0] * sample->pose.v[0];
-    mrr += sample->weight * sample->pose.v[1] * sample->pose.v[1];
+    mn += set->weight[i];
+    mx += set->weight[i] * set->x[i];
+    my += set->weight[i] * set->y[i];
+    mrr += set->weight[i] * set->x[i] * set->x[i];
+    mrr += set->weight[i] * set->y[i] * set->y[i];
   }
 
   mean->v[0] = mx / mn;
@@ -37,7 +37,7 @@
 
 #include "nav2_util/pf/pf.hpp"
 #include "nav2_util/pf/pf_pdf.hpp"
-#include "nav2_util/pf/pf_kdtree.hpp"
+#include "nav2_util/pf/pf_hashgrid.hpp"
 
 // Draw the statistics
 void pf_draw_statistics(pf_t * pf, rtk_fig_t * fig);
@@ -49,17 +49,14 @@ void pf_draw_samples(pf_t * pf, rtk_fig_t * fig, int max_samples)
   int i;
   double px, py, pa;
   pf_sample_set_t * set;
-  pf_sample_t * sample;
 
   set = pf->sets + pf->current_set;
   max_samples = MIN(max_samples, set->sample_count);
 
   for (i = 0; i < max_samples; i++) {
-    sample = set->samples + i;
-
-    px = sample->pose.v[0];
-    py = sample->pose.v[1];
-    pa = sample->pose.v[2];
+    px = set->x[i];
+    py = set->y[i];
+    pa = set->theta[i];
 
     // printf("%f %f\n", px, py);
 
@@ -70,7 +67,7 @@ void pf_draw_samples(pf_t * pf, rtk_fig_t * fig, int max_samples)
 }
 
 
-// Draw the hitogram (kd tree)
+// Draw the histogram
 void pf_draw_hist(pf_t * pf, rtk_fig_t * fig)
 {
   pf_sample_set_t * set;
@@ -78,7 +75,7 @@ void pf_draw_hist(pf_t * pf, rtk_fig_t * fig)
   set = pf->sets + pf->current_set;
 
   rtk_fig_color(fig, 0.0, 0.0, 1.0);
-  pf_kdtree_draw(set->kdtree, fig);
+  pf_hashgrid_draw(set->histogram, fig);
 }
 
 
@@ -0,0 +1,329 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "nav2_util/pf/pf_vector.hpp"
+#include "nav2_util/pf/pf_hashgrid.hpp"
+
+
+// Compute the grid coordinates of a pose
+static void pf_hashgrid_key(pf_hashgrid_t * self, pf_vector_t pose, int key[]);
+
+// Find the slot holding the given key, or the empty slot where it would go
+static int pf_hashgrid_find_slot(pf_hashgrid_t * self, const int key[]);
+
+// Find the bin with the given key, or NULL if it is not occupied
+static pf_hashgrid_bin_t * pf_hashgrid_find_bin(pf_hashgrid_t * self, const int key[]);
+
+// (Re)build the hash table for the current bin capacity
+static void pf_hashgrid_alloc_slots(pf_hashgrid_t * self);
+
+// Find the root of the tree holding the given bin
+static int pf_hashgrid_find_root(pf_hashgrid_t * self, int i);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Create a histogram
+pf_hashgrid_t * pf_hashgrid_alloc(int max_size)
+{
+  pf_hashgrid_t * self;
+
+  self = calloc(1, sizeof(pf_hashgrid_t));
+
+  self->size[0] = 0.50;
+  self->size[1] = 0.50;
+  self->size[2] = (10 * M_PI / 180);
+
+  self->bin_count = 0;
+  self->bin_max_count = max_size > 0 ? max_size : 1;
+  self->bins = calloc(self->bin_max_count, sizeof(pf_hashgrid_bin_t));
+  self->parent = calloc(self->bin_max_count, sizeof(int));
+
+  pf_hashgrid_alloc_slots(self);
+
+  return self;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Destroy a histogram
+void pf_hashgrid_free(pf_hashgrid_t * self)
+{
+  free(self->slots);
+  free(self->parent);
+  free(self->bins);
+  free(self);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Clear all entries from the histogram. Only the slots that are in use are
+// reset, so the cost is proportional to the number of occupied bins.
+void pf_hashgrid_clear(pf_hashgrid_t * self)
+{
+  int i;
+
+  for (i = 0; i < self->bin_count; i++) {
+    self->slots[self->bins[i].slot] = -1;
+  }
+  self->bin_count = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Insert a pose into the histogram
+int pf_hashgrid_insert(pf_hashgrid_t * self, pf_vector_t pose, double value)
+{
+  int key[3];
+  int slot;
+  pf_hashgrid_bin_t * bin;
+
+  pf_hashgrid_key(self, pose, key);
+
+  slot = pf_hashgrid_find_slot(self, key);
+  if (self->slots[slot] >= 0) {
+    self->bins[self->slots[slot]].value += value;
+    return self->slots[slot];
+  }
+
+  // Grow the bins and rehash if we run out of room
+  if (self->bin_count == self->bin_max_count) {
+    self->bin_max_count *= 2;
+    self->bins = realloc(self->bins, self->bin_max_count * sizeof(pf_hashgrid_bin_t));
+    self->parent = realloc(self->parent, self->bin_max_count * sizeof(int));
+    pf_hashgrid_alloc_slots(self);
+    slot = pf_hashgrid_find_slot(self, key);
+  }
+
+  bin = self->bins + self->bin_count;
+  bin->key[0] = key[0];
+  bin->key[1] = key[1];
+  bin->key[2] = key[2];
+  bin->value = value;
+  bin->cluster = -1;
+  bin->slot = slot;
+
+  self->slots[slot] = self->bin_count;
+  return self->bin_count++;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Determine the probability estimate for the given pose
+double pf_hashgrid_get_prob(pf_hashgrid_t * self, pf_vector_t pose)
+{
+  int key[3];
+  pf_hashgrid_bin_t * bin;
+
+  pf_hashgrid_key(self, pose, key);
+
+  bin = pf_hashgrid_find_bin(self, key);
+  if (bin == NULL) {
+    return 0.0;
+  }
+  return bin->value;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Determine the cluster label for the given pose
+int pf_hashgrid_get_cluster(pf_hashgrid_t * self, pf_vector_t pose)
+{
+  int key[3];
+  pf_hashgrid_bin_t * bin;
+
+  pf_hashgrid_key(self, pose, key);
+
+  bin = pf_hashgrid_find_bin(self, key);
+  if (bin == NULL) {
+    return -1;
+  }
+  return bin->cluster;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Cluster the occupied bins. Bins are connected when they are neighbors in the
+// 3x3x3 block around each other. Every bin is joined with the neighbors that
+// follow it in grid order, which covers each neighboring pair once, in a
+// union-find forest whose roots are the lowest bin index of their tree. A
+// single pass in bin order then numbers the clusters.
+int pf_hashgrid_cluster(pf_hashgrid_t * self)
+{
+  int i, j, n, a, b, cluster_count;
+  int nkey[3];
+  pf_hashgrid_bin_t * bin, * nbin;
+
+  for (i = 0; i < self->bin_count; i++) {
+    self->parent[i] = i;
+  }
+
+  for (i = 0; i < self->bin_count; i++) {
+    bin = self->bins + i;
+
+    // The 13 neighbor offsets (j / 9 - 1, (j % 9) / 3 - 1, j % 3 - 1) after the
+    // center of the block, j = 13
+    for (j = 14; j < 3 * 3 * 3; j++) {
+      nkey[0] = bin->key[0] + (j / 9) - 1;
+      nkey[1] = bin->key[1] + ((j % 9) / 3) - 1;
+      nkey[2] = bin->key[2] + ((j % 9) % 3) - 1;
+
+      nbin = pf_hashgrid_find_bin(self, nkey);
+      if (nbin == NULL) {
+        continue;
+      }
+
+      // Join the trees, keeping the lowest index as the root
+      n = nbin - self->bins;
+      a = pf_hashgrid_find_root(self, i);
+      b = pf_hashgrid_find_root(self, n);
+      if (a < b) {
+        self->parent[b] = a;
+      } else if (b < a) {
+        self->parent[a] = b;
+      }
+    }
+  }
+
+  // A root comes before the other bins of its tree, so it is labelled first
+  cluster_count = 0;
+  for (i = 0; i < self->bin_count; i++) {
+    a = pf_hashgrid_find_root(self, i);
+    if (a == i) {
+      self->bins[i].cluster = cluster_count++;
+    } else {
+      self->bins[i].cluster = self->bins[a].cluster;
+    }
+  }
+
+  return cluster_count;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compute the grid coordinates of a pose
+void pf_hashgrid_key(pf_hashgrid_t * self, pf_vector_t pose, int key[])
+{
+  key[0] = floor(pose.v[0] / self->size[0]);
+  key[1] = floor(pose.v[1] / self->size[1]);
+  key[2] = floor(pose.v[2] / self->size[2]);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Find the slot holding the given key, or the empty slot where it would go.
+// Collisions are resolved with linear probing; the table is kept at most half
+// full so probe sequences stay short.
+int pf_hashgrid_find_slot(pf_hashgrid_t * self, const int key[])
+{
+  unsigned int hash;
+  int slot;
+  pf_hashgrid_bin_t * bin;
+
+  hash = ((unsigned int)key[0] * 73856093u) ^
+    ((unsigned int)key[1] * 19349663u) ^
+    ((unsigned int)key[2] * 83492791u);
+  hash ^= hash >> 16;
+
+  slot = hash & self->slot_mask;
+  while (self->slots[slot] >= 0) {
+    bin = self->bins + self->slots[slot];
+    if (bin->key[0] == key[0] && bin->key[1] == key[1] && bin->key[2] == key[2]) {
+      break;
+    }
+    slot = (slot + 1) & self->slot_mask;
+  }
+  return slot;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Find the bin with the given key
+pf_hashgrid_bin_t * pf_hashgrid_find_bin(pf_hashgrid_t * self, const int key[])
+{
+  int slot;
+
+  slot = pf_hashgrid_find_slot(self, key);
+  if (self->slots[slot] < 0) {
+    return NULL;
+  }
+  return self->bins + self->slots[slot];
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Find the root of the tree holding the given bin, halving the path on the way
+int pf_hashgrid_find_root(pf_hashgrid_t * self, int i)
+{
+  while (self->parent[i] != i) {
+    self->parent[i] = self->parent[self->parent[i]];
+    i = self->parent[i];
+  }
+  return i;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// (Re)build the hash table for the current bin capacity
+void pf_hashgrid_alloc_slots(pf_hashgrid_t * self)
+{
+  int i, slot_count;
+
+  slot_count = 1;
+  while (slot_count < 2 * self->bin_max_count) {
+    slot_count *= 2;
+  }
+
+  free(self->slots);
+  self->slot_mask = slot_count - 1;
+  self->slots = malloc(slot_count * sizeof(int));
+  for (i = 0; i < slot_count; i++) {
+    self->slots[i] = -1;
+  }
+
+  // Re-insert the occupied bins
+  for (i = 0; i < self->bin_count; i++) {
+    self->bins[i].slot = pf_hashgrid_find_slot(self, self->bins[i].key);
+    self->slots[self->bins[i].slot] = i;
+  }
+}
+
+
+#ifdef INCLUDE_RTKGUI
+
+////////////////////////////////////////////////////////////////////////////////
+// Draw the histogram
+void pf_hashgrid_draw(pf_hashgrid_t * self, rtk_fig_t * fig)
+{
+  int i;
+  double ox, oy;
+  char text[64];
+  pf_hashgrid_bin_t * bin;
+
+  for (i = 0; i < self->bin_count; i++) {
+    bin = self->bins + i;
+
+    ox = (bin->key[0] + 0.5) * self->size[0];
+    oy = (bin->key[1] + 0.5) * self->size[1];
+
+    rtk_fig_rectangle(fig, ox, oy, 0.0, self->size[0], self->size[1], 0);
+
+    snprintf(text, sizeof(text), "%d", bin->cluster);
+    rtk_fig_text(fig, ox, oy, 0.0, text);
+  }
+}
+
+#endif
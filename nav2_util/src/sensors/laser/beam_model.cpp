@@ -39,6 +39,7 @@ BeamModel::BeamModel(
   z_max_ = z_max;
   lambda_short_ = lambda_short;
   chi_outlier_ = chi_outlier;
+  map_update_free_dist(map);
 }
 
 // Determine the probability for the given pose
@@ -46,56 +47,67 @@ double
 BeamModel::sensorFunction(LaserData * data, pf_sample_set_t * set)
 {
   BeamModel * self;
+
+  self = reinterpret_cast<BeamModel *>(data->laser);
+
+  auto weigh = [self, data, set](unsigned int, int begin, int end) {
+      return self->weighSampleRange(data, set, begin, end);
+    };
+
+  return self->weighSamples(set, weigh);
+}
+
+// Weigh the samples in [begin, end) and return the sum of their new weights
+double
+BeamModel::weighSampleRange(
+  LaserData * data, pf_sample_set_t * set, int begin, int end)
+{
   int i, j, step;
   double z, pz;
   double p;
   double map_range;
   double obs_range, obs_bearing;
   double total_weight;
-  pf_sample_t * sample;
   pf_vector_t pose;
 
-  self = reinterpret_cast<BeamModel *>(data->laser);
-
   total_weight = 0.0;
 
   // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++) {
-    sample = set->samples + j;
-    pose = sample->pose;
+  for (j = begin; j < end; j++) {
+    pose = pf_sample_pose(set, j);
 
     // Take account of the laser pose relative to the robot
-    pose = pf_vector_coord_add(self->laser_pose_, pose);
+    pose = pf_vector_coord_add(laser_pose_, pose);
 
     p = 1.0;
 
-    step = (data->range_count - 1) / (self->max_beams_ - 1);
+    step = (data->range_count - 1) / (max_beams_ - 1);
     for (i = 0; i < data->range_count; i += step) {
       obs_range = data->ranges[i][0];
       obs_bearing = data->ranges[i][1];
 
       // Compute the range according to the map
-      map_range = map_calc_range(self->map_, pose.v[0], pose.v[1],
+      map_range = map_calc_range(map_, pose.v[0], pose.v[1],
           pose.v[2] + obs_bearing, data->range_max);
       pz = 0.0;
 
       // Part 1: good, but noisy, hit
       z = obs_range - map_range;
-      pz += self->z_hit_ * exp(-(z * z) / (2 * self->sigma_hit_ * self->sigma_hit_));
+      pz += z_hit_ * exp(-(z * z) / (2 * sigma_hit_ * sigma_hit_));
 
       // Part 2: short reading from unexpected obstacle (e.g., a person)
       if (z < 0) {
-        pz += self->z_short_ * self->lambda_short_ * exp(-self->lambda_short_ * obs_range);
+        pz += z_short_ * lambda_short_ * exp(-lambda_short_ * obs_range);
       }
 
       // Part 3: Failure to detect obstacle, reported as max-range
       if (obs_range == data->range_max) {
-        pz += self->z_max_ * 1.0;
+        pz += z_max_ * 1.0;
       }
 
       // Part 4: Random measurements
       if (obs_range < data->range_max) {
-        pz += self->z_rand_ * 1.0 / data->range_max;
+        pz += z_rand_ * 1.0 / data->range_max;
       }
 
       // TODO(?): outlier rejection for short readings
@@ -108,8 +120,8 @@ BeamModel::sensorFunction(LaserData * data, pf_sample_set_t * set)
       p += pz * pz * pz;
     }
 
-    sample->weight *= p;
-    total_weight += sample->weight;
+    set->weight[j] *= p;
+    total_weight += set->weight[j];
   }
 
   return total_weight;
@@ -126,4 +138,13 @@ BeamModel::sensorUpdate(pf_t * pf, LaserData * data)
   return true;
 }
 
+pf_sensor_model_fn_t
+BeamModel::sensorModel() const
+{
+  if (max_beams_ < 2) {
+    return NULL;
+  }
+  return (pf_sensor_model_fn_t) sensorFunction;
+}
+
 }  // namespace nav2_util
@@ -25,13 +25,25 @@
 #include <assert.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
 #include "nav2_util/sensors/laser/laser.hpp"
 
 namespace nav2_util
 {
 
+// The likelihood fields in use by some laser. A table lives as long as a laser
+// holds it. Tables are matched on the map's generation as well as its address,
+// since a new map may be allocated where a freed one was while lasers of the
+// old map are still around.
+static std::mutex likelihood_fields_mutex;
+static std::vector<std::weak_ptr<LikelihoodField>> likelihood_fields;
+
 Laser::Laser(size_t max_beams, map_t * map)
-: max_samples_(0), max_obs_(0), temp_obs_(NULL)
+: max_samples_(0), max_obs_(0), temp_obs_(NULL),
+  adaptive_beams_(false)
 {
   max_beams_ = max_beams;
   map_ = map;
@@ -71,4 +83,285 @@ Laser::SetLaserPose(pf_vector_t & laser_pose)
   laser_pose_ = laser_pose;
 }
 
+void
+LaserData::resizeRanges(int count)
+{
+  if (count > range_capacity_) {
+    delete[] ranges;
+    ranges = new double[count][2];
+    range_capacity_ = count;
+  }
+  range_count = count;
+}
+
+void
+Laser::setWorkerPool(std::shared_ptr<WorkerPool> pool)
+{
+  pool_ = pool;
+}
+
+bool
+Laser::fusedSensorUpdate(pf_t * pf, const std::vector<LaserData *> & data)
+{
+  if (data.size() == 1) {
+    return data[0]->laser->sensorUpdate(pf, data[0]);
+  }
+
+  std::vector<pf_sensor_model_fn_t> sensor_fns;
+  std::vector<void *> sensor_data;
+  for (LaserData * laser_data : data) {
+    pf_sensor_model_fn_t sensor_fn = laser_data->laser->sensorModel();
+    if (sensor_fn != NULL) {
+      sensor_fns.push_back(sensor_fn);
+      sensor_data.push_back(laser_data);
+    }
+  }
+  if (sensor_fns.empty()) {
+    return false;
+  }
+
+  pf_update_sensors(pf, sensor_fns.size(), sensor_fns.data(), sensor_data.data());
+  return true;
+}
+
+void
+Laser::setAdaptiveBeamSelection(bool adaptive)
+{
+  adaptive_beams_ = adaptive;
+}
+
+void
+Laser::selectBeams(LaserData * data, int step)
+{
+  beams_.clear();
+
+  if (!adaptive_beams_) {
+    for (int i = 0; i < data->range_count; i += step) {
+      beams_.push_back(i);
+    }
+    return;
+  }
+
+  // Keep the valid readings whose endpoint is at least a cell away from the one of the
+  // previous reading kept, since those add nothing to the weight but their cost
+  beam_candidates_.clear();
+  beam_points_.clear();
+  double last_x = 0.0, last_y = 0.0;
+  for (int i = 0; i < data->range_count; i++) {
+    double range = data->ranges[i][0];
+    double bearing = data->ranges[i][1];
+
+    // Max range readings, NaNs and non positive ranges carry no hit
+    if (!(range < data->range_max) || !(range > 0.0)) {
+      continue;
+    }
+
+    double x = range * cos(bearing);
+    double y = range * sin(bearing);
+    if (!beam_candidates_.empty() && hypot(x - last_x, y - last_y) < map_->scale) {
+      continue;
+    }
+
+    beam_candidates_.push_back(i);
+    beam_points_.push_back(x);
+    beam_points_.push_back(y);
+    last_x = x;
+    last_y = y;
+  }
+
+  int count = beam_candidates_.size();
+  if (count <= max_beams_) {
+    beams_ = beam_candidates_;
+    return;
+  }
+
+  // Describe each candidate by its bearing and by the orientation of the surface it hits,
+  // both as points on the unit circle. The orientation is estimated from the endpoints of
+  // the neighbouring candidates, when they are close enough to lie on the same surface.
+  const double max_gap = 10 * map_->scale;
+  const double * points = beam_points_.data();
+  beam_features_.resize(4 * count);
+  for (int k = 0; k < count; k++) {
+    double x = points[2 * k];
+    double y = points[2 * k + 1];
+    double bearing = data->ranges[beam_candidates_[k]][1];
+
+    bool has_prev = k > 0 && hypot(points[2 * k - 2] - x, points[2 * k - 1] - y) < max_gap;
+    bool has_next = k + 1 < count &&
+      hypot(points[2 * k + 2] - x, points[2 * k + 3] - y) < max_gap;
+
+    double tx = -sin(bearing), ty = cos(bearing);
+    if (has_prev || has_next) {
+      tx = (has_next ? points[2 * k + 2] : x) - (has_prev ? points[2 * k - 2] : x);
+      ty = (has_next ? points[2 * k + 3] : y) - (has_prev ? points[2 * k - 1] : y);
+    }
+    // Surfaces have no direction, so the angle of the tangent is doubled
+    double orientation = 2 * atan2(ty, tx);
+
+    beam_features_[4 * k] = cos(bearing);
+    beam_features_[4 * k + 1] = sin(bearing);
+    beam_features_[4 * k + 2] = cos(orientation);
+    beam_features_[4 * k + 3] = sin(orientation);
+  }
+
+  // Farthest point sampling: starting from the first candidate, repeatedly pick the
+  // candidate whose features are the farthest from all those picked so far
+  beam_spread_.assign(count, std::numeric_limits<double>::max());
+  int picked = 0;
+  for (int n = 0; n < max_beams_; n++) {
+    beams_.push_back(picked);
+    beam_spread_[picked] = -1.0;
+    const double * f = beam_features_.data() + 4 * picked;
+
+    int next = picked;
+    double next_spread = -1.0;
+    for (int k = 0; k < count; k++) {
+      const double * g = beam_features_.data() + 4 * k;
+      double d = (f[0] - g[0]) * (f[0] - g[0]) + (f[1] - g[1]) * (f[1] - g[1]) +
+        (f[2] - g[2]) * (f[2] - g[2]) + (f[3] - g[3]) * (f[3] - g[3]);
+      beam_spread_[k] = std::min(beam_spread_[k], d);
+      if (beam_spread_[k] > next_spread) {
+        next_spread = beam_spread_[k];
+        next = k;
+      }
+    }
+    picked = next;
+  }
+
+  // Weigh the chosen beams in scan order
+  std::sort(beams_.begin(), beams_.end());
+  for (int & beam : beams_) {
+    beam = beam_candidates_[beam];
+  }
+}
+
+double
+Laser::weighSamples(pf_sample_set_t * set, const WeighFn & fn)
+{
+  // Below this many particles per shard the wake-up cost outweighs the gain
+  const int min_shard = 64;
+
+  if (!pool_ || pool_->size() == 1) {
+    return fn(0, 0, set->sample_count);
+  }
+
+  lane_totals_.assign(pool_->size(), 0.0);
+  unsigned int lanes = pool_->run(set->sample_count,
+      [this, &fn](unsigned int lane, int begin, int end) {
+        lane_totals_[lane] = fn(lane, begin, end);
+      }, min_shard);
+
+  double total_weight = 0.0;
+  for (unsigned int lane = 0; lane < lanes; lane++) {
+    total_weight += lane_totals_[lane];
+  }
+  return total_weight;
+}
+
+void
+Laser::updateLikelihoodField(double range_max, bool log_scale)
+{
+  const size_t count = static_cast<size_t>(map_->size_x) * map_->size_y + 1;
+  auto matches = [&](const LikelihoodField & field) {
+      return field.map == map_ && field.map_generation == map_->generation &&
+             field.values.size() == count &&
+             field.z_hit == z_hit_ && field.z_rand == z_rand_ &&
+             field.sigma_hit == sigma_hit_ && field.max_occ_dist == map_->max_occ_dist &&
+             field.range_max == range_max && field.log_scale == log_scale;
+    };
+
+  if (likelihood_field_ && matches(*likelihood_field_)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(likelihood_fields_mutex);
+
+  // Drop the tables no laser uses anymore, and look for one built by another laser
+  likelihood_field_.reset();
+  for (size_t i = 0; i < likelihood_fields.size(); ) {
+    auto field = likelihood_fields[i].lock();
+    if (!field) {
+      likelihood_fields[i] = likelihood_fields.back();
+      likelihood_fields.pop_back();
+      continue;
+    }
+    if (!likelihood_field_ && matches(*field)) {
+      likelihood_field_ = field;
+    }
+    i++;
+  }
+  if (likelihood_field_) {
+    return;
+  }
+
+  auto field = std::make_shared<LikelihoodField>();
+  field->map = map_;
+  field->map_generation = map_->generation;
+  field->z_hit = z_hit_;
+  field->z_rand = z_rand_;
+  field->sigma_hit = sigma_hit_;
+  field->max_occ_dist = map_->max_occ_dist;
+  field->range_max = range_max;
+  field->log_scale = log_scale;
+  field->values.resize(count);
+
+  auto fill = [&field](unsigned int, int begin, int end) {
+      field->fill(begin, end);
+    };
+
+  if (pool_) {
+    pool_->run(static_cast<int>(count), fill, 4096);
+  } else {
+    fill(0, 0, static_cast<int>(count));
+  }
+
+  likelihood_fields.push_back(field);
+  likelihood_field_ = field;
+}
+
+void
+LikelihoodField::fill(int begin, int end)
+{
+  double z_hit_denom = 2 * sigma_hit * sigma_hit;
+  double z_rand_term = z_rand / range_max;
+
+  for (int i = begin; i < end; i++) {
+    double z = map->occ_dist[i];
+    // Gaussian model on the distance to the closest obstacle, plus random measurements
+    // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
+    double pz = z_hit * exp(-(z * z) / z_hit_denom) + z_rand_term;
+    values[i] = log_scale ? log(pz) : pz;
+  }
+}
+
+void
+Laser::updateMapRegion(map_t * map, int min_i, int min_j, int max_i, int max_j)
+{
+  if (min_i > max_i || min_j > max_j) {
+    return;
+  }
+
+  // The cells whose distance to an obstacle may have changed
+  const int margin = static_cast<int>(map->max_occ_dist / map->scale) + 1;
+  int x0 = std::max(min_i - margin, 0);
+  int x1 = std::min(max_i + margin + 1, map->size_x);
+  int y0 = std::max(min_j - margin, 0);
+  int y1 = std::min(max_j + margin + 1, map->size_y);
+  const size_t count = static_cast<size_t>(map->size_x) * map->size_y + 1;
+
+  std::lock_guard<std::mutex> lock(likelihood_fields_mutex);
+  for (auto & weak_field : likelihood_fields) {
+    auto field = weak_field.lock();
+    // A stale table is rebuilt in full on the next update anyway
+    if (!field || field->map != map || field->map_generation != map->generation ||
+      field->values.size() != count || field->max_occ_dist != map->max_occ_dist)
+    {
+      continue;
+    }
+    for (int j = y0; j < y1; j++) {
+      field->fill(MAP_INDEX(map, x0, j), MAP_INDEX(map, x0, j) + std::max(x1 - x0, 0));
+    }
+  }
+}
+
 }  // namespace nav2_util
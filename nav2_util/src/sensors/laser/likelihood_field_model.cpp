@@ -30,108 +30,139 @@ namespace nav2_util
 LikelihoodFieldModel::LikelihoodFieldModel(
   double z_hit, double z_rand, double sigma_hit,
   double max_occ_dist, size_t max_beams, map_t * map)
-: Laser(max_beams, map)
+: Laser(max_beams, map), beam_count_(0)
 {
   z_hit_ = z_hit;
   z_rand_ = z_rand;
   sigma_hit_ = sigma_hit;
-  map_update_cspace(map, max_occ_dist);
+  // The cspace may already have been computed, or loaded from a cache, for
+  // this map and distance
+  if (map->max_occ_dist != max_occ_dist) {
+    map_update_cspace(map, max_occ_dist);
+  }
+}
+
+void
+LikelihoodFieldModel::prepareBeams(LaserData * data)
+{
+  int step = (data->range_count - 1) / (max_beams_ - 1);
+
+  // Step size must be at least 1
+  if (step < 1) {
+    step = 1;
+  }
+
+  selectBeams(data, step);
+
+  beam_gx_.resize(beams_.size());
+  beam_gy_.resize(beam_gx_.size());
+
+  beam_count_ = 0;
+  for (int i : beams_) {
+    double obs_range = data->ranges[i][0];
+    double obs_bearing = data->ranges[i][1];
+
+    // This model ignores max range readings
+    if (obs_range >= data->range_max) {
+      continue;
+    }
+
+    // Check for NaN
+    if (obs_range != obs_range) {
+      continue;
+    }
+
+    beam_gx_[beam_count_] = obs_range * cos(obs_bearing) / map_->scale;
+    beam_gy_[beam_count_] = obs_range * sin(obs_bearing) / map_->scale;
+    beam_count_++;
+  }
+}
+
+// Both loops below are free of calls and branches so that the compiler can turn
+// them into vector code, including gathered loads from the likelihood field
+double
+LikelihoodFieldModel::scoreBeams(const pf_vector_t & pose, int * cells) const
+{
+  const double cos_th = cos(pose.v[2]);
+  const double sin_th = sin(pose.v[2]);
+
+  // Grid coordinates of the laser, such that MAP_GXWX reduces to a floor
+  const double gx = (pose.v[0] - map_->origin_x) / map_->scale + 0.5;
+  const double gy = (pose.v[1] - map_->origin_y) / map_->scale + 0.5;
+  const int half_x = map_->size_x / 2;
+  const int half_y = map_->size_y / 2;
+  const int size_x = map_->size_x;
+  const int size_y = map_->size_y;
+  const int off_map = size_x * size_y;
+  const double * beam_gx = beam_gx_.data();
+  const double * beam_gy = beam_gy_.data();
+
+  // Compute the map cell of the endpoint of every beam
+  for (int k = 0; k < beam_count_; k++) {
+    int mi = static_cast<int>(floor(gx + cos_th * beam_gx[k] - sin_th * beam_gy[k])) + half_x;
+    int mj = static_cast<int>(floor(gy + sin_th * beam_gx[k] + cos_th * beam_gy[k])) + half_y;
+    bool valid = (mi >= 0) & (mi < size_x) & (mj >= 0) & (mj < size_y);
+    cells[k] = valid ? mi + mj * size_x : off_map;
+  }
+
+  // Look up the likelihood of every hit. Off-map hits are penalized as max
+  // distance by the extra entry past the last cell.
+  const float * field = likelihood_field_->values.data();
+
+  double p = 1.0;
+  for (int k = 0; k < beam_count_; k++) {
+    float pz = field[cells[k]];
+    // here we have an ad-hoc weighting scheme for combining beam probs
+    // works well, though...
+    p += pz * pz * pz;
+  }
+
+  return p;
 }
 
 double
 LikelihoodFieldModel::sensorFunction(LaserData * data, pf_sample_set_t * set)
 {
   LikelihoodFieldModel * self;
-  int i, j, step;
-  double z, pz;
-  double p;
-  double obs_range, obs_bearing;
-  double total_weight;
-  pf_sample_t * sample;
-  pf_vector_t pose;
-  pf_vector_t hit;
 
   self = reinterpret_cast<LikelihoodFieldModel *>(data->laser);
 
-  total_weight = 0.0;
-
-  // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++) {
-    sample = set->samples + j;
-    pose = sample->pose;
+  self->updateLikelihoodField(data->range_max, false);
+  self->prepareBeams(data);
+  self->lane_cells_.resize(self->laneCount() * self->beam_gx_.size());
 
-    // Take account of the laser pose relative to the robot
-    pose = pf_vector_coord_add(self->laser_pose_, pose);
+  auto weigh = [self, set](unsigned int lane, int begin, int end) {
+      return self->weighSampleRange(set, lane, begin, end);
+    };
 
-    p = 1.0;
+  return self->weighSamples(set, weigh);
+}
 
-    // Pre-compute a couple of things
-    double z_hit_denom = 2 * self->sigma_hit_ * self->sigma_hit_;
-    double z_rand_mult = 1.0 / data->range_max;
+// Weigh the samples in [begin, end) and return the sum of their new weights
+double
+LikelihoodFieldModel::weighSampleRange(
+  pf_sample_set_t * set, unsigned int lane, int begin, int end)
+{
+  int * cells = lane_cells_.data() + lane * beam_gx_.size();
+  double total_weight;
+  pf_vector_t pose;
 
-    step = (data->range_count - 1) / (self->max_beams_ - 1);
+  total_weight = 0.0;
 
-    // Step size must be at least 1
-    if (step < 1) {
-      step = 1;
-    }
+  // Compute the sample weights
+  for (int j = begin; j < end; j++) {
+    pose = pf_sample_pose(set, j);
 
-    for (i = 0; i < data->range_count; i += step) {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
-
-      // This model ignores max range readings
-      if (obs_range >= data->range_max) {
-        continue;
-      }
-
-      // Check for NaN
-      if (obs_range != obs_range) {
-        continue;
-      }
-
-      pz = 0.0;
-
-      // Compute the endpoint of the beam
-      hit.v[0] = pose.v[0] + obs_range * cos(pose.v[2] + obs_bearing);
-      hit.v[1] = pose.v[1] + obs_range * sin(pose.v[2] + obs_bearing);
-
-      // Convert to map grid coords.
-      int mi, mj;
-      mi = MAP_GXWX(self->map_, hit.v[0]);
-      mj = MAP_GYWY(self->map_, hit.v[1]);
-
-      // Part 1: Get distance from the hit to closest obstacle.
-      // Off-map penalized as max distance
-      if (!MAP_VALID(self->map_, mi, mj)) {
-        z = self->map_->max_occ_dist;
-      } else {
-        z = self->map_->cells[MAP_INDEX(self->map_, mi, mj)].occ_dist;
-      }
-      // Gaussian model
-      // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
-      pz += self->z_hit_ * exp(-(z * z) / z_hit_denom);
-      // Part 2: random measurements
-      pz += self->z_rand_ * z_rand_mult;
-
-      // TODO(?): outlier rejection for short readings
-
-      assert(pz <= 1.0);
-      assert(pz >= 0.0);
-      //      p *= pz;
-      // here we have an ad-hoc weighting scheme for combining beam probs
-      // works well, though...
-      p += pz * pz * pz;
-    }
+    // Take account of the laser pose relative to the robot
+    pose = pf_vector_coord_add(laser_pose_, pose);
 
-    sample->weight *= p;
-    total_weight += sample->weight;
+    set->weight[j] *= scoreBeams(pose, cells);
+    total_weight += set->weight[j];
   }
 
   return total_weight;
 }
 
-
 bool
 LikelihoodFieldModel::sensorUpdate(pf_t * pf, LaserData * data)
 {
@@ -143,4 +174,13 @@ LikelihoodFieldModel::sensorUpdate(pf_t * pf, LaserData * data)
   return true;
 }
 
+pf_sensor_model_fn_t
+LikelihoodFieldModel::sensorModel() const
+{
+  if (max_beams_ < 2) {
+    return NULL;
+  }
+  return (pf_sensor_model_fn_t) sensorFunction;
+}
+
 }  // namespace nav2_util
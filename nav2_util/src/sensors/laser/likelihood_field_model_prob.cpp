@@ -44,7 +44,11 @@ LikelihoodFieldModelProb::LikelihoodFieldModelProb(
   beam_skip_distance_ = beam_skip_distance;
   beam_skip_threshold_ = beam_skip_threshold;
   beam_skip_error_threshold_ = beam_skip_error_threshold;
-  map_update_cspace(map, max_occ_dist);
+  // The cspace may already have been computed, or loaded from a cache, for
+  // this map and distance
+  if (map->max_occ_dist != max_occ_dist) {
+    map_update_cspace(map, max_occ_dist);
+  }
 }
 
 // Determine the probability for the given pose
@@ -52,14 +56,8 @@ double
 LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set)
 {
   LikelihoodFieldModelProb * self;
-  int i, j, step;
-  double z, pz;
-  double log_p;
-  double obs_range, obs_bearing;
+  int step;
   double total_weight;
-  pf_sample_t * sample;
-  pf_vector_t pose;
-  pf_vector_t hit;
 
   self = reinterpret_cast<LikelihoodFieldModelProb *>(data->laser);
 
@@ -72,11 +70,10 @@ LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set
     step = 1;
   }
 
-  // Pre-compute a couple of things
-  double z_hit_denom = 2 * self->sigma_hit_ * self->sigma_hit_;
-  double z_rand_mult = 1.0 / data->range_max;
-
-  double max_dist_prob = exp(-(self->map_->max_occ_dist * self->map_->max_occ_dist) / z_hit_denom);
+  // Make sure the log likelihood of a hit in each cell is up to date
+  self->updateLikelihoodField(data->range_max, true);
+  const float * field = self->likelihood_field_->values.data();
+  const int off_map = self->map_->size_x * self->map_->size_y;
 
   // Beam skipping - ignores beams for which a majoirty of particles do not agree with the map
   // prevents correct particles from getting down weighted because of unexpected obstacles
@@ -91,14 +88,16 @@ LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set
     do_beamskip = false;
   }
 
-  // we need a count the no of particles for which the beam agreed with the map
-  int * obs_count = new int[self->max_beams_]();
+  // we need a count the no of particles for which the beam agreed with the map, kept per lane
+  // so that the shards of a parallel update do not contend, and summed up afterwards
+  unsigned int lanes = self->laneCount();
+  self->obs_count_.assign(self->max_beams_ * lanes, 0);
+  int * obs_count = self->obs_count_.data();
 
   // we also need a mask of which observations to integrate (to decide which beams to integrate to
   // all particles)
-  bool * obs_mask = new bool[self->max_beams_]();
-
-  int beam_ind = 0;
+  self->obs_mask_.assign(self->max_beams_, false);
+  char * obs_mask = self->obs_mask_.data();
 
   // realloc indicates if we need to reallocate the temp data structure needed to do beamskipping
   bool realloc = false;
@@ -118,82 +117,93 @@ LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set
     }
   }
 
-  // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++) {
-    sample = set->samples + j;
-    pose = sample->pose;
-
-    // Take account of the laser pose relative to the robot
-    pose = pf_vector_coord_add(self->laser_pose_, pose);
-
-    log_p = 0;
-
-    beam_ind = 0;
-
-    for (i = 0; i < data->range_count; i += step, beam_ind++) {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
-
-      // This model ignores max range readings
-      if (obs_range >= data->range_max) {
-        continue;
-      }
-
-      // Check for NaN
-      if (obs_range != obs_range) {
-        continue;
-      }
-
-      pz = 0.0;
-
-      // Compute the endpoint of the beam
-      hit.v[0] = pose.v[0] + obs_range * cos(pose.v[2] + obs_bearing);
-      hit.v[1] = pose.v[1] + obs_range * sin(pose.v[2] + obs_bearing);
+  self->selectBeams(data, step);
+  const int * beams = self->beams_.data();
+  const int beam_total = self->beams_.size();
 
-      // Convert to map grid coords.
-      int mi, mj;
-      mi = MAP_GXWX(self->map_, hit.v[0]);
-      mj = MAP_GYWY(self->map_, hit.v[1]);
-
-      // Part 1: Get distance from the hit to closest obstacle.
-      // Off-map penalized as max distance
-
-      if (!MAP_VALID(self->map_, mi, mj)) {
-        pz += self->z_hit_ * max_dist_prob;
-      } else {
-        z = self->map_->cells[MAP_INDEX(self->map_, mi, mj)].occ_dist;
-        if (z < beam_skip_distance) {
-          obs_count[beam_ind] += 1;
+  // Compute the sample weights
+  auto weigh = [&](unsigned int lane, int begin, int end) {
+      int * lane_obs_count = obs_count + lane * self->max_beams_;
+      double lane_weight = 0.0;
+      double log_p;
+      double obs_range, obs_bearing;
+      pf_vector_t pose;
+      pf_vector_t hit;
+
+      for (int j = begin; j < end; j++) {
+        pose = pf_sample_pose(set, j);
+
+        // Take account of the laser pose relative to the robot
+        pose = pf_vector_coord_add(self->laser_pose_, pose);
+
+        log_p = 0;
+
+        for (int beam_ind = 0; beam_ind < beam_total; beam_ind++) {
+          int i = beams[beam_ind];
+          obs_range = data->ranges[i][0];
+          obs_bearing = data->ranges[i][1];
+
+          // This model ignores max range readings, and NaNs. With beam skipping they
+          // are recorded as neutral observations.
+          if (obs_range >= data->range_max || obs_range != obs_range) {
+            if (do_beamskip) {
+              self->temp_obs_[j][beam_ind] = 0.0;
+            }
+            continue;
+          }
+
+          // Compute the endpoint of the beam
+          hit.v[0] = pose.v[0] + obs_range * cos(pose.v[2] + obs_bearing);
+          hit.v[1] = pose.v[1] + obs_range * sin(pose.v[2] + obs_bearing);
+
+          // Convert to map grid coords.
+          int mi, mj;
+          mi = MAP_GXWX(self->map_, hit.v[0]);
+          mj = MAP_GYWY(self->map_, hit.v[1]);
+
+          // Look up the log likelihood of the hit, which accounts for the distance from
+          // the hit to the closest obstacle and for random measurements.
+          // Off-map penalized as max distance
+          int cell = off_map;
+          if (MAP_VALID(self->map_, mi, mj)) {
+            cell = MAP_INDEX(self->map_, mi, mj);
+            if (do_beamskip && self->map_->occ_dist[cell] < beam_skip_distance) {
+              lane_obs_count[beam_ind] += 1;
+            }
+          }
+
+          // TODO(?): outlier rejection for short readings
+
+          if (!do_beamskip) {
+            log_p += field[cell];
+          } else {
+            self->temp_obs_[j][beam_ind] = field[cell];
+          }
+        }
+        if (!do_beamskip) {
+          set->weight[j] *= exp(log_p);
+          lane_weight += set->weight[j];
         }
-        pz += self->z_hit_ * exp(-(z * z) / z_hit_denom);
       }
+      return lane_weight;
+    };
 
-      // Gaussian model
-      // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
-
-      // Part 2: random measurements
-      pz += self->z_rand_ * z_rand_mult;
-
-      assert(pz <= 1.0);
-      assert(pz >= 0.0);
+  total_weight = self->weighSamples(set, weigh);
 
-      // TODO(?): outlier rejection for short readings
-
-      if (!do_beamskip) {
-        log_p += log(pz);
-      } else {
-        self->temp_obs_[j][beam_ind] = pz;
+  if (do_beamskip) {
+    int beam_ind;
+
+    // Fold the per-lane agreement counts into the first lane. Only the first
+    // beam_total slots are in use, adaptive selection may pick fewer than
+    // max_beams_ beams.
+    for (unsigned int lane = 1; lane < lanes; lane++) {
+      for (beam_ind = 0; beam_ind < beam_total; beam_ind++) {
+        obs_count[beam_ind] += obs_count[lane * self->max_beams_ + beam_ind];
       }
     }
-    if (!do_beamskip) {
-      sample->weight *= exp(log_p);
-      total_weight += sample->weight;
-    }
-  }
 
-  if (do_beamskip) {
     int skipped_beam_count = 0;
-    for (beam_ind = 0; beam_ind < self->max_beams_; beam_ind++) {
+    for (beam_ind = 0; beam_ind < beam_total; beam_ind++) {
       if ((obs_count[beam_ind] / static_cast<double>(set->sample_count)) > beam_skip_threshold) {
         obs_mask[beam_ind] = true;
       } else {
@@ -208,7 +218,7 @@ LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set
     // the right solution
     bool error = false;
 
-    if (skipped_beam_count >= (beam_ind * self->beam_skip_error_threshold_)) {
+    if (skipped_beam_count >= (beam_total * self->beam_skip_error_threshold_)) {
       fprintf(stderr,
         "Over %f%% of the observations were not in the map - pf may have converged to wrong pose -"
         " integrating all observations\n",
@@ -216,26 +226,28 @@ LikelihoodFieldModelProb::sensorFunction(LaserData * data, pf_sample_set_t * set
       error = true;
     }
 
-    for (j = 0; j < set->sample_count; j++) {
-      sample = set->samples + j;
-      pose = sample->pose;
+    // temp_obs_ holds the log likelihood of every beam of every sample
+    auto reweigh = [&](unsigned int, int begin, int end) {
+        double lane_weight = 0.0;
+        for (int j = begin; j < end; j++) {
+          double log_p = 0;
 
-      log_p = 0;
+          for (int k = 0; k < beam_total; k++) {
+            if (error || obs_mask[k]) {
+              log_p += self->temp_obs_[j][k];
+            }
+          }
 
-      for (beam_ind = 0; beam_ind < self->max_beams_; beam_ind++) {
-        if (error || obs_mask[beam_ind]) {
-          log_p += log(self->temp_obs_[j][beam_ind]);
-        }
-      }
+          set->weight[j] *= exp(log_p);
 
-      sample->weight *= exp(log_p);
+          lane_weight += set->weight[j];
+        }
+        return lane_weight;
+      };
 
-      total_weight += sample->weight;
-    }
+    total_weight = self->weighSamples(set, reweigh);
   }
 
-  delete[] obs_count;
-  delete[] obs_mask;
   return total_weight;
 }
 
@@ -250,4 +262,13 @@ LikelihoodFieldModelProb::sensorUpdate(pf_t * pf, LaserData * data)
   return true;
 }
 
+pf_sensor_model_fn_t
+LikelihoodFieldModelProb::sensorModel() const
+{
+  if (max_beams_ < 2) {
+    return NULL;
+  }
+  return (pf_sensor_model_fn_t) sensorFunction;
+}
+
 }  // namespace nav2_util
@@ -0,0 +1,110 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_util/worker_pool.hpp"
+
+#include <algorithm>
+
+namespace nav2_util
+{
+
+WorkerPool::WorkerPool(unsigned int num_threads)
+: task_(nullptr), count_(0), lanes_(0), pending_(0), generation_(0), stop_(false)
+{
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned int lane = 1; lane < num_threads; ++lane) {
+    workers_.emplace_back(&WorkerPool::workerLoop, this, lane);
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto & worker : workers_) {
+    worker.join();
+  }
+}
+
+unsigned int
+WorkerPool::run(int count, const Task & task, int min_shard)
+{
+  if (count <= 0) {
+    return 0;
+  }
+
+  unsigned int lanes = size();
+  if (min_shard > 1) {
+    lanes = std::min(lanes, static_cast<unsigned int>(std::max(1, count / min_shard)));
+  }
+  lanes = std::min(lanes, static_cast<unsigned int>(count));
+
+  if (lanes == 1) {
+    task(0, 0, count);
+    return 1;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    count_ = count;
+    lanes_ = lanes;
+    pending_ = lanes - 1;
+    ++generation_;
+  }
+  work_cv_.notify_all();
+
+  task(0, 0, shardBegin(count, 1, lanes));
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this] {return pending_ == 0;});
+  task_ = nullptr;
+  return lanes;
+}
+
+void
+WorkerPool::workerLoop(unsigned int lane)
+{
+  unsigned long seen = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_cv_.wait(lock, [this, seen] {return stop_ || generation_ != seen;});
+    if (stop_) {
+      return;
+    }
+    seen = generation_;
+    if (lane >= lanes_) {
+      continue;
+    }
+
+    const Task * task = task_;
+    int begin = shardBegin(count_, lane, lanes_);
+    int end = shardBegin(count_, lane + 1, lanes_);
+
+    lock.unlock();
+    (*task)(lane, begin, end);
+    lock.lock();
+
+    if (--pending_ == 0) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+}  // namespace nav2_util
@@ -0,0 +1,51 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_util/latency_stats.hpp"
+#include "gtest/gtest.h"
+
+using nav2_util::LatencyStats;
+
+TEST(LatencyStats, Percentiles)
+{
+  LatencyStats stats(1000);
+  EXPECT_EQ(stats.percentile(50), 0.0);
+
+  // Insert 1..101 out of order
+  for (int i = 0; i < 101; i++) {
+    stats.add((i * 37) % 101 + 1);
+  }
+  EXPECT_EQ(stats.count(), 101u);
+  EXPECT_EQ(stats.percentile(0), 1.0);
+  EXPECT_EQ(stats.percentile(50), 51.0);
+  EXPECT_EQ(stats.percentile(90), 91.0);
+  EXPECT_EQ(stats.percentile(100), 101.0);
+  EXPECT_EQ(stats.max(), 101.0);
+}
+
+TEST(LatencyStats, WindowKeepsRecentSamples)
+{
+  LatencyStats stats(10);
+  for (int i = 0; i < 25; i++) {
+    stats.add(i);
+  }
+  EXPECT_EQ(stats.count(), 10u);
+  EXPECT_EQ(stats.totalCount(), 25u);
+  EXPECT_EQ(stats.percentile(0), 15.0);
+  EXPECT_EQ(stats.max(), 24.0);
+
+  stats.clear();
+  EXPECT_EQ(stats.count(), 0u);
+  EXPECT_EQ(stats.totalCount(), 0u);
+}
@@ -0,0 +1,140 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include "nav2_util/map/map.hpp"
+#include "nav2_util/random.hpp"
+#include "nav2_util/sensors/laser/laser.hpp"
+#include "gtest/gtest.h"
+
+using nav2_util::LikelihoodField;
+using nav2_util::LikelihoodFieldModel;
+using nav2_util::Xoshiro256;
+
+namespace
+{
+
+// Exposes the likelihood field of the model
+class TestLaser : public LikelihoodFieldModel
+{
+public:
+  TestLaser(double sigma_hit, map_t * map)
+  : LikelihoodFieldModel(0.95, 0.05, sigma_hit, 0.5, 60, map)
+  {
+  }
+
+  const LikelihoodField * field(double range_max)
+  {
+    updateLikelihoodField(range_max, false);
+    return likelihood_field_.get();
+  }
+};
+
+map_t * randomMap(int size_x, int size_y, double occupied, Xoshiro256 & rng)
+{
+  map_t * map = map_alloc();
+  map_alloc_cells(map, size_x, size_y);
+  map->scale = 0.05;
+  for (int i = 0; i < size_x * size_y; i++) {
+    map->occ_state[i] = rng.uniform() < occupied ? +1 : -1;
+  }
+  return map;
+}
+
+// A table built from scratch for the parameters of the given one
+std::vector<float> freshValues(const LikelihoodField & field)
+{
+  LikelihoodField fresh = field;
+  fresh.fill(0, static_cast<int>(fresh.values.size()));
+  return fresh.values;
+}
+
+}  // namespace
+
+TEST(LikelihoodField, SharedBetweenLasers)
+{
+  Xoshiro256 rng(9);
+  map_t * map = randomMap(80, 60, 0.01, rng);
+
+  auto first = std::make_unique<TestLaser>(0.2, map);
+  auto second = std::make_unique<TestLaser>(0.2, map);
+  auto other = std::make_unique<TestLaser>(0.3, map);
+
+  const LikelihoodField * field = first->field(30.0);
+  ASSERT_NE(field, nullptr);
+  EXPECT_EQ(field->values.size(), 80u * 60u + 1u);
+  EXPECT_EQ(second->field(30.0), field);
+  EXPECT_NE(other->field(30.0), field);
+  EXPECT_NE(second->field(20.0), field);
+  EXPECT_EQ(first->field(30.0), field);
+
+  first.reset();
+  second.reset();
+  other.reset();
+  map_free(map);
+}
+
+TEST(LikelihoodField, MapRegionUpdateRefreshesSharedTable)
+{
+  Xoshiro256 rng(13);
+  map_t * map = randomMap(90, 70, 0.01, rng);
+
+  auto first = std::make_unique<TestLaser>(0.2, map);
+  auto second = std::make_unique<TestLaser>(0.2, map);
+  const LikelihoodField * field = first->field(30.0);
+  ASSERT_EQ(second->field(30.0), field);
+
+  for (int j = 30; j <= 34; j++) {
+    for (int i = 40; i <= 45; i++) {
+      map->occ_state[MAP_INDEX(map, i, j)] = +1;
+    }
+  }
+  map_update_cspace_region(map, 40, 30, 45, 34);
+  nav2_util::Laser::updateMapRegion(map, 40, 30, 45, 34);
+
+  EXPECT_EQ(first->field(30.0), field);
+  EXPECT_EQ(field->values, freshValues(*field));
+
+  first.reset();
+  second.reset();
+  map_free(map);
+}
+
+TEST(LikelihoodField, RebuiltForNewMapOfSameSize)
+{
+  Xoshiro256 rng(21);
+  map_t * map = randomMap(80, 60, 0.01, rng);
+  map_update_cspace(map, 0.5);
+
+  // A laser of the old map outlives it, keeping its table alive
+  auto old_laser = std::make_unique<TestLaser>(0.2, map);
+  const LikelihoodField * old_field = old_laser->field(30.0);
+  const std::vector<float> old_values = old_field->values;
+
+  // The new map is likely to be allocated at the old map's address
+  map_free(map);
+  map = randomMap(80, 60, 0.05, rng);
+  map_update_cspace(map, 0.5);
+
+  auto laser = std::make_unique<TestLaser>(0.2, map);
+  const LikelihoodField * field = laser->field(30.0);
+  EXPECT_NE(field, old_field);
+  EXPECT_EQ(field->map_generation, map->generation);
+  EXPECT_EQ(field->values, freshValues(*field));
+  EXPECT_NE(field->values, old_values);
+
+  laser.reset();
+  old_laser.reset();
+  map_free(map);
+}
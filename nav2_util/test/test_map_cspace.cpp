@@ -0,0 +1,248 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <dirent.h>
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+#include "nav2_util/map/map.hpp"
+#include "nav2_util/random.hpp"
+#include "nav2_util/worker_pool.hpp"
+#include "gtest/gtest.h"
+
+using nav2_util::Xoshiro256;
+
+namespace
+{
+
+map_t * randomMap(int size_x, int size_y, double occupied, Xoshiro256 & rng)
+{
+  map_t * map = map_alloc();
+  map_alloc_cells(map, size_x, size_y);
+  map->scale = 0.05;
+  for (int i = 0; i < size_x * size_y; i++) {
+    map->occ_state[i] = rng.uniform() < occupied ? +1 : -1;
+  }
+  return map;
+}
+
+// The cspace distances by brute force: the distance of every cell to every
+// occupied cell, saturated at max_occ_dist beyond the cell radius like
+// map_update_cspace() does
+std::vector<float> bruteForceCspace(map_t * map, double max_occ_dist)
+{
+  const int cell_radius = static_cast<int>(max_occ_dist / map->scale);
+  const long long max_sq = static_cast<long long>(cell_radius) * cell_radius;
+
+  std::vector<std::pair<int, int>> occupied;
+  for (int j = 0; j < map->size_y; j++) {
+    for (int i = 0; i < map->size_x; i++) {
+      if (map->occ_state[MAP_INDEX(map, i, j)] == +1) {
+        occupied.emplace_back(i, j);
+      }
+    }
+  }
+
+  std::vector<float> dist(map->size_x * map->size_y + 1, max_occ_dist);
+  for (int j = 0; j < map->size_y; j++) {
+    for (int i = 0; i < map->size_x; i++) {
+      long long best = max_sq + 1;
+      for (const auto & cell : occupied) {
+        long long di = i - cell.first;
+        long long dj = j - cell.second;
+        best = std::min(best, di * di + dj * dj);
+      }
+      if (best <= max_sq) {
+        dist[MAP_INDEX(map, i, j)] = sqrt(static_cast<double>(best)) * map->scale;
+      }
+    }
+  }
+  return dist;
+}
+
+// Names of the entries of a directory, other than . and ..
+std::vector<std::string> listDirectory(const std::string & path)
+{
+  std::vector<std::string> names;
+  DIR * dir = opendir(path.c_str());
+  while (struct dirent * entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name != "." && name != "..") {
+      names.push_back(name);
+    }
+  }
+  closedir(dir);
+  return names;
+}
+
+}  // namespace
+
+TEST(MapCspace, MatchesBruteForce)
+{
+  Xoshiro256 rng(19);
+
+  for (int trial = 0; trial < 30; trial++) {
+    // Small maps, from empty to cluttered, with max_occ_dist from below a
+    // cell to past the size of the map, and not a whole number of cells
+    const int size_x = 1 + static_cast<int>(rng.uniform() * 60);
+    const int size_y = 1 + static_cast<int>(rng.uniform() * 60);
+    const double occupied = trial % 5 == 0 ? 0.0 : 0.2 * rng.uniform() * rng.uniform();
+    const double max_occ_dist = 0.03 + 4.0 * rng.uniform();
+    map_t * map = randomMap(size_x, size_y, occupied, rng);
+
+    // Obstacles on the map edges
+    if (trial % 3 == 1) {
+      map->occ_state[MAP_INDEX(map, 0, size_y - 1)] = +1;
+      map->occ_state[MAP_INDEX(map, size_x - 1, static_cast<int>(rng.uniform() * size_y))] = +1;
+    }
+
+    map_update_cspace(map, max_occ_dist);
+    std::vector<float> expected = bruteForceCspace(map, max_occ_dist);
+    for (int i = 0; i <= size_x * size_y; i++) {
+      ASSERT_EQ(map->occ_dist[i], expected[i]) << "trial " << trial << ", cell " << i;
+    }
+    map_free(map);
+  }
+
+  // A map large enough to be split over a pool
+  nav2_util::WorkerPool pool(4);
+  map_t * map = randomMap(300, 260, 0.0005, rng);
+  map_update_cspace(map, 1.0, &pool);
+  std::vector<float> expected = bruteForceCspace(map, 1.0);
+  for (int i = 0; i <= 300 * 260; i++) {
+    ASSERT_EQ(map->occ_dist[i], expected[i]) << "cell " << i;
+  }
+  map_free(map);
+}
+
+TEST(MapCspace, RegionUpdateMatchesFullUpdate)
+{
+  Xoshiro256 rng(7);
+  map_t * map = randomMap(173, 121, 0.002, rng);
+  map_t * reference = randomMap(173, 121, 0.0, rng);
+  map_update_cspace(map, 0.5);
+
+  for (int edit = 0; edit < 40; edit++) {
+    // Toggle a random block of cells, sometimes at the map border
+    int min_i = static_cast<int>(rng.uniform() * map->size_x);
+    int min_j = static_cast<int>(rng.uniform() * map->size_y);
+    int max_i = std::min(min_i + static_cast<int>(rng.uniform() * 8), map->size_x - 1);
+    int max_j = std::min(min_j + static_cast<int>(rng.uniform() * 8), map->size_y - 1);
+    for (int j = min_j; j <= max_j; j++) {
+      for (int i = min_i; i <= max_i; i++) {
+        int8_t & state = map->occ_state[MAP_INDEX(map, i, j)];
+        state = state == +1 ? -1 : +1;
+      }
+    }
+    map_update_cspace_region(map, min_i, min_j, max_i, max_j);
+
+    std::copy(map->occ_state, map->occ_state + map->size_x * map->size_y, reference->occ_state);
+    map_update_cspace(reference, 0.5);
+    for (int i = 0; i <= map->size_x * map->size_y; i++) {
+      ASSERT_EQ(map->occ_dist[i], reference->occ_dist[i]) << "edit " << edit << ", cell " << i;
+    }
+  }
+
+  map_free(reference);
+  map_free(map);
+}
+
+TEST(MapCspace, PoolUpdateMatchesDefaultUpdate)
+{
+  Xoshiro256 rng(5);
+  nav2_util::WorkerPool pool(3);
+  map_t * map = randomMap(311, 290, 0.002, rng);
+  map_t * reference = randomMap(311, 290, 0.0, rng);
+  std::copy(map->occ_state, map->occ_state + map->size_x * map->size_y, reference->occ_state);
+
+  map_update_cspace(map, 0.5, &pool);
+  map_update_cspace(reference, 0.5);
+  for (int i = 0; i <= map->size_x * map->size_y; i++) {
+    ASSERT_EQ(map->occ_dist[i], reference->occ_dist[i]) << "cell " << i;
+  }
+
+  // A large edit runs on the pool, a small one on the calling thread
+  map->occ_state[MAP_INDEX(map, 150, 140)] = +1;
+  reference->occ_state[MAP_INDEX(reference, 150, 140)] = +1;
+  map_update_cspace_region(map, 150, 140, 150, 140, &pool);
+  for (int j = 0; j < 290; j += 7) {
+    map->occ_state[MAP_INDEX(map, 20, j)] = +1;
+    reference->occ_state[MAP_INDEX(reference, 20, j)] = +1;
+  }
+  map_update_cspace_region(map, 20, 0, 20, 289, &pool);
+  map_update_cspace(reference, 0.5);
+  for (int i = 0; i <= map->size_x * map->size_y; i++) {
+    ASSERT_EQ(map->occ_dist[i], reference->occ_dist[i]) << "cell " << i;
+  }
+
+  map_free(reference);
+  map_free(map);
+}
+
+TEST(MapCspace, RegionUpdateNeedsCspace)
+{
+  Xoshiro256 rng(3);
+  map_t * map = randomMap(20, 20, 0.1, rng);
+  map_update_cspace_region(map, 0, 0, 19, 19);
+  EXPECT_LT(map->max_occ_dist, 0.0);
+  for (int i = 0; i < 20 * 20; i++) {
+    EXPECT_EQ(map->occ_dist[i], 0.0f);
+  }
+  map_free(map);
+}
+
+TEST(MapCspace, CacheRoundTrip)
+{
+  char dir_template[] = "/tmp/test_map_cspace_XXXXXX";
+  ASSERT_NE(mkdtemp(dir_template), nullptr);
+  const std::string dir = dir_template;
+  const std::string filename = dir + "/map.cspace";
+
+  Xoshiro256 rng(11);
+  map_t * map = randomMap(97, 64, 0.01, rng);
+  map_update_cspace(map, 0.4);
+  const uint64_t key = map_cspace_key(map, 0.4);
+  ASSERT_EQ(map_save_cspace(map, key, filename.c_str()), 0);
+  ASSERT_EQ(map_save_cspace(map, key, filename.c_str()), 0);
+
+  // Only the cache file is left behind, no temporary files
+  EXPECT_EQ(listDirectory(dir), std::vector<std::string>{"map.cspace"});
+
+  map_t * loaded = randomMap(97, 64, 0.0, rng);
+  std::copy(map->occ_state, map->occ_state + map->size_x * map->size_y, loaded->occ_state);
+  ASSERT_EQ(map_load_cspace(loaded, key, filename.c_str()), 0);
+  EXPECT_EQ(loaded->max_occ_dist, map->max_occ_dist);
+  for (int i = 0; i <= map->size_x * map->size_y; i++) {
+    ASSERT_EQ(loaded->occ_dist[i], map->occ_dist[i]) << "cell " << i;
+  }
+
+  // A file saved for a different map or max_occ_dist is rejected
+  EXPECT_EQ(map_load_cspace(loaded, key + 1, filename.c_str()), -1);
+  EXPECT_EQ(map_load_cspace(loaded, map_cspace_key(map, 0.5), filename.c_str()), -1);
+
+  // So is a truncated file
+  ASSERT_EQ(truncate(filename.c_str(), 1000), 0);
+  EXPECT_EQ(map_load_cspace(loaded, key, filename.c_str()), -1);
+
+  EXPECT_EQ(map_load_cspace(loaded, key, (dir + "/missing.cspace").c_str()), -1);
+
+  unlink(filename.c_str());
+  rmdir(dir.c_str());
+  map_free(loaded);
+  map_free(map);
+}
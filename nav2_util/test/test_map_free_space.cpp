@@ -0,0 +1,103 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <vector>
+#include "nav2_util/map/map.hpp"
+#include "nav2_util/random.hpp"
+#include "gtest/gtest.h"
+
+using nav2_util::Xoshiro256;
+
+namespace
+{
+
+map_t * randomMap(int size_x, int size_y, double occupied, Xoshiro256 & rng)
+{
+  map_t * map = map_alloc();
+  map_alloc_cells(map, size_x, size_y);
+  map->scale = 0.05;
+  for (int i = 0; i < size_x * size_y; i++) {
+    map->occ_state[i] = rng.uniform() < occupied ? +1 : -1;
+  }
+  return map;
+}
+
+// Set a random block of cells, sometimes at the map border, to random states,
+// and return its bounds
+void editBlock(map_t * map, int max_size, Xoshiro256 & rng, int bounds[4])
+{
+  bounds[0] = static_cast<int>(rng.uniform() * map->size_x);
+  bounds[1] = static_cast<int>(rng.uniform() * map->size_y);
+  bounds[2] = std::min(bounds[0] + static_cast<int>(rng.uniform() * max_size), map->size_x - 1);
+  bounds[3] = std::min(bounds[1] + static_cast<int>(rng.uniform() * max_size), map->size_y - 1);
+  const double occupied = rng.uniform();
+  for (int j = bounds[1]; j <= bounds[3]; j++) {
+    for (int i = bounds[0]; i <= bounds[2]; i++) {
+      map->occ_state[MAP_INDEX(map, i, j)] = rng.uniform() < occupied ? +1 : -1;
+    }
+  }
+}
+
+}  // namespace
+
+TEST(MapFreeSpace, FreeCellsRegionUpdateMatchesFullUpdate)
+{
+  Xoshiro256 rng(4);
+  map_t * map = randomMap(143, 97, 0.3, rng);
+  map_t * reference = randomMap(143, 97, 0.0, rng);
+  map_update_free_cells(map);
+
+  for (int edit = 0; edit < 200; edit++) {
+    int bounds[4];
+    editBlock(map, 30, rng, bounds);
+    int count = map_update_free_cells_region(map, bounds[0], bounds[1], bounds[2], bounds[3]);
+
+    std::copy(map->occ_state, map->occ_state + map->size_x * map->size_y, reference->occ_state);
+    ASSERT_EQ(count, map_update_free_cells(reference)) << "edit " << edit;
+    ASSERT_EQ(map->free_count, reference->free_count) << "edit " << edit;
+    for (int n = 0; n < map->free_count; n++) {
+      ASSERT_EQ(map->free_cells[n], reference->free_cells[n]) << "edit " << edit << ", n " << n;
+    }
+  }
+
+  map_free(reference);
+  map_free(map);
+}
+
+TEST(MapFreeSpace, FreeDistRegionUpdateMatchesFullUpdate)
+{
+  Xoshiro256 rng(6);
+
+  // Large enough that edits in the middle leave most of the map untouched,
+  // and sparse enough that distances saturate at 255
+  map_t * map = randomMap(1400, 1100, 0.000002, rng);
+  map_t * reference = randomMap(1400, 1100, 0.0, rng);
+  map_update_free_dist(map);
+
+  for (int edit = 0; edit < 12; edit++) {
+    int bounds[4];
+    editBlock(map, 40, rng, bounds);
+    map_update_free_dist_region(map, bounds[0], bounds[1], bounds[2], bounds[3]);
+
+    std::copy(map->occ_state, map->occ_state + map->size_x * map->size_y, reference->occ_state);
+    map_update_free_dist(reference);
+    for (int i = 0; i < map->size_x * map->size_y; i++) {
+      ASSERT_EQ(map->free_dist[i], reference->free_dist[i]) << "edit " << edit << ", cell " << i;
+    }
+  }
+
+  map_free(reference);
+  map_free(map);
+}
@@ -0,0 +1,138 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <math.h>
+#include "nav2_util/map/map.hpp"
+#include "nav2_util/random.hpp"
+#include "gtest/gtest.h"
+
+using nav2_util::Xoshiro256;
+
+namespace
+{
+
+// A map with the given fractions of occupied and unknown cells, and free
+// cells otherwise
+map_t * randomMap(int size_x, int size_y, double occupied, double unknown, Xoshiro256 & rng)
+{
+  map_t * map = map_alloc();
+  map_alloc_cells(map, size_x, size_y);
+  map->scale = 0.05;
+  map->origin_x = 1.3;
+  map->origin_y = -0.7;
+  for (int i = 0; i < size_x * size_y; i++) {
+    double u = rng.uniform();
+    map->occ_state[i] = u < occupied ? +1 : (u < occupied + unknown ? 0 : -1);
+  }
+  return map;
+}
+
+// The range of the ray stepping through every cell, as without free_dist
+double rangeWithoutFreeDist(map_t * map, double ox, double oy, double oa, double max_range)
+{
+  uint8_t * free_dist = map->free_dist;
+  map->free_dist = NULL;
+  double range = map_calc_range(map, ox, oy, oa, max_range);
+  map->free_dist = free_dist;
+  return range;
+}
+
+// Cast rays from random points on and around the map in random directions,
+// with ranges from within a cell to past the map, and compare the ranges with
+// and without free_dist
+void checkRandomRays(map_t * map, int count, Xoshiro256 & rng)
+{
+  const double width = map->size_x * map->scale;
+  const double height = map->size_y * map->scale;
+  const double diagonal = hypot(width, height);
+
+  for (int n = 0; n < count; n++) {
+    double ox = MAP_WXGX(map, 0) + (1.2 * rng.uniform() - 0.1) * width;
+    double oy = MAP_WYGY(map, 0) + (1.2 * rng.uniform() - 0.1) * height;
+    double oa = (2.0 * rng.uniform() - 1.0) * M_PI;
+    // Also exactly horizontal, vertical and diagonal rays
+    if (n % 8 == 0) {
+      oa = (n / 8 % 8) * M_PI / 4;
+    }
+    double max_range = 1.5 * diagonal * rng.uniform() * rng.uniform();
+
+    ASSERT_EQ(map_calc_range(map, ox, oy, oa, max_range),
+      rangeWithoutFreeDist(map, ox, oy, oa, max_range)) <<
+      "ray " << n << " from (" << ox << ", " << oy << ") at " << oa << ", max " << max_range;
+  }
+}
+
+}  // namespace
+
+TEST(MapRange, FreeDistDoesNotChangeRanges)
+{
+  Xoshiro256 rng(8);
+
+  for (int trial = 0; trial < 40; trial++) {
+    const int size_x = 1 + static_cast<int>(rng.uniform() * 200);
+    const int size_y = 1 + static_cast<int>(rng.uniform() * 200);
+    const double occupied = 0.05 * rng.uniform() * rng.uniform();
+    map_t * map = randomMap(size_x, size_y, occupied, occupied * rng.uniform(), rng);
+    ASSERT_EQ(map_update_free_dist(map), 0);
+    checkRandomRays(map, 2000, rng);
+    map_free(map);
+  }
+}
+
+TEST(MapRange, FreeDistSaturatedDoesNotChangeRanges)
+{
+  Xoshiro256 rng(12);
+
+  // Open space far wider than 255 cells, so that the distances saturate,
+  // with a few obstacles
+  map_t * map = randomMap(900, 700, 0.0, 0.0, rng);
+  map->occ_state[MAP_INDEX(map, 100, 120)] = +1;
+  map->occ_state[MAP_INDEX(map, 790, 600)] = +1;
+  map->occ_state[MAP_INDEX(map, 450, 40)] = 0;
+  ASSERT_EQ(map_update_free_dist(map), 0);
+  int saturated = 0;
+  for (int i = 0; i < map->size_x * map->size_y; i++) {
+    saturated += map->free_dist[i] == 255;
+  }
+  EXPECT_GT(saturated, 0);
+
+  checkRandomRays(map, 20000, rng);
+  map_free(map);
+}
+
+TEST(MapRange, KnownRanges)
+{
+  map_t * map = map_alloc();
+  map_alloc_cells(map, 20, 10);
+  map->scale = 0.1;
+  for (int i = 0; i < 20 * 10; i++) {
+    map->occ_state[i] = -1;
+  }
+  map->occ_state[MAP_INDEX(map, 15, 5)] = +1;
+
+  // From the center of cell (5, 5) along the row, to the obstacle and past
+  // the side of the map
+  double ox = MAP_WXGX(map, 5);
+  double oy = MAP_WYGY(map, 5);
+  EXPECT_DOUBLE_EQ(map_calc_range(map, ox, oy, 0.0, 5.0), 1.0);
+  EXPECT_DOUBLE_EQ(map_calc_range(map, ox, oy, M_PI, 5.0), 0.6);
+  EXPECT_DOUBLE_EQ(map_calc_range(map, ox, oy, 0.0, 0.5), 0.5);
+
+  ASSERT_EQ(map_update_free_dist(map), 0);
+  EXPECT_DOUBLE_EQ(map_calc_range(map, ox, oy, 0.0, 5.0), 1.0);
+  EXPECT_DOUBLE_EQ(map_calc_range(map, ox, oy, M_PI, 5.0), 0.6);
+  EXPECT_DOUBLE_EQ(map_calc_range(map, ox, oy, 0.0, 0.5), 0.5);
+
+  map_free(map);
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include "nav2_util/map_loader/occupancy_conversion.hpp"
+#include "nav2_util/random.hpp"
+#include "gtest/gtest.h"
+
+using nav2_util::Xoshiro256;
+
+namespace
+{
+
+// The per-pixel conversion the loaders used before the lookup tables
+std::vector<int8_t> referenceConversion(
+  const std::vector<unsigned char> & pixels, int width, int height, int rowstride,
+  int n_channels, bool has_alpha, bool negate, double occupancy_threshold,
+  double free_threshold, MapMode mode)
+{
+  std::vector<int8_t> data(width * height);
+  int avg_channels = (mode == TRINARY || !has_alpha) ? n_channels : n_channels - 1;
+
+  for (int j = 0; j < height; j++) {
+    for (int i = 0; i < width; i++) {
+      const unsigned char * p = pixels.data() + j * rowstride + i * n_channels;
+      int color_sum = 0;
+      for (int k = 0; k < avg_channels; k++) {
+        color_sum += p[k];
+      }
+      double color_avg = color_sum / static_cast<double>(avg_channels);
+      int alpha = n_channels == 1 ? 1 : p[n_channels - 1];
+      if (negate) {
+        color_avg = 255 - color_avg;
+      }
+
+      unsigned char value;
+      double occ = (255 - color_avg) / 255.0;
+      if (mode == RAW) {
+        value = color_avg;
+      } else if (occ > occupancy_threshold) {
+        value = +100;
+      } else if (occ < free_threshold) {
+        value = 0;
+      } else if (mode == TRINARY || alpha < 1.0) {
+        value = -1;
+      } else {
+        double ratio = (occ - free_threshold) / (occupancy_threshold - free_threshold);
+        value = 99 * ratio;
+      }
+      data[width * (height - j - 1) + i] = value;
+    }
+  }
+  return data;
+}
+
+}  // namespace
+
+TEST(OccupancyConversion, MatchesPerPixelConversion)
+{
+  Xoshiro256 rng(11);
+  const int width = 37;
+  const int height = 150;
+
+  for (int n_channels = 1; n_channels <= 4; n_channels++) {
+    // Rows are padded like SDL surfaces
+    const int rowstride = (width * n_channels + 3) & ~3;
+    std::vector<unsigned char> pixels(rowstride * height);
+    for (auto & pixel : pixels) {
+      // Favor the extremes so that transparent pixels are common
+      double u = rng.uniform();
+      pixel = u < 0.1 ? 0 : (u > 0.9 ? 255 : static_cast<unsigned char>(rng() & 0xff));
+    }
+
+    for (MapMode mode : {TRINARY, SCALE, RAW}) {
+      for (bool has_alpha : {false, true}) {
+        if (has_alpha && n_channels == 1) {
+          // A grayscale image has no alpha channel
+          continue;
+        }
+        for (bool negate : {false, true}) {
+          std::vector<int8_t> expected = referenceConversion(
+            pixels, width, height, rowstride, n_channels, has_alpha, negate, 0.65, 0.196, mode);
+          std::vector<int8_t> data(width * height);
+          map_loader::convertImageToOccupancy(
+            pixels.data(), width, height, rowstride, n_channels, has_alpha, negate, 0.65, 0.196,
+            mode, data.data());
+          EXPECT_EQ(data, expected) << "channels " << n_channels << ", mode " << mode <<
+            ", alpha " << has_alpha << ", negate " << negate;
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,163 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <math.h>
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+#include "nav2_util/pf/pf_hashgrid.hpp"
+#include "nav2_util/random.hpp"
+#include "gtest/gtest.h"
+
+using nav2_util::Xoshiro256;
+
+namespace
+{
+
+// A pose at the center of the given grid cell
+pf_vector_t cellPose(pf_hashgrid_t * grid, int i, int j, int k)
+{
+  pf_vector_t pose;
+  pose.v[0] = (i + 0.5) * grid->size[0];
+  pose.v[1] = (j + 0.5) * grid->size[1];
+  pose.v[2] = (k + 0.5) * grid->size[2];
+  return pose;
+}
+
+// Label the connected components of the bins, where bins are connected when
+// they are among each other's 26 neighbors, by a flood fill over all pairs.
+// Components are numbered in the order of their first bin.
+std::vector<int> bruteForceClusters(pf_hashgrid_t * grid)
+{
+  std::vector<int> labels(grid->bin_count, -1);
+  int cluster_count = 0;
+
+  for (int seed = 0; seed < grid->bin_count; seed++) {
+    if (labels[seed] >= 0) {
+      continue;
+    }
+    std::vector<int> stack = {seed};
+    labels[seed] = cluster_count;
+    while (!stack.empty()) {
+      const int * a = grid->bins[stack.back()].key;
+      stack.pop_back();
+      for (int n = 0; n < grid->bin_count; n++) {
+        const int * b = grid->bins[n].key;
+        if (labels[n] < 0 && abs(a[0] - b[0]) <= 1 && abs(a[1] - b[1]) <= 1 &&
+          abs(a[2] - b[2]) <= 1)
+        {
+          labels[n] = cluster_count;
+          stack.push_back(n);
+        }
+      }
+    }
+    cluster_count++;
+  }
+  return labels;
+}
+
+}  // namespace
+
+TEST(PfHashgrid, InsertAndLookup)
+{
+  pf_hashgrid_t * grid = pf_hashgrid_alloc(16);
+
+  int a = pf_hashgrid_insert(grid, cellPose(grid, 1, 2, 3), 0.25);
+  int b = pf_hashgrid_insert(grid, cellPose(grid, -4, 0, -1), 0.5);
+  EXPECT_NE(a, b);
+
+  // Poses in the same cell accumulate into the same bin
+  pf_vector_t pose = cellPose(grid, 1, 2, 3);
+  pose.v[0] += 0.4 * grid->size[0];
+  EXPECT_EQ(pf_hashgrid_insert(grid, pose, 0.125), a);
+  EXPECT_EQ(grid->bin_count, 2);
+
+  EXPECT_DOUBLE_EQ(pf_hashgrid_get_prob(grid, cellPose(grid, 1, 2, 3)), 0.375);
+  EXPECT_DOUBLE_EQ(pf_hashgrid_get_prob(grid, cellPose(grid, -4, 0, -1)), 0.5);
+  EXPECT_EQ(pf_hashgrid_get_prob(grid, cellPose(grid, 1, 2, 4)), 0.0);
+  EXPECT_EQ(pf_hashgrid_get_cluster(grid, cellPose(grid, 0, 0, 0)), -1);
+
+  pf_hashgrid_clear(grid);
+  EXPECT_EQ(grid->bin_count, 0);
+  EXPECT_EQ(pf_hashgrid_get_prob(grid, cellPose(grid, 1, 2, 3)), 0.0);
+
+  pf_hashgrid_free(grid);
+}
+
+TEST(PfHashgrid, GrowsPastHalfFull)
+{
+  pf_hashgrid_t * grid = pf_hashgrid_alloc(4);
+
+  const int count = 1000;
+  for (int n = 0; n < count; n++) {
+    int bin = pf_hashgrid_insert(grid, cellPose(grid, n % 10, (n / 10) % 10, n / 100), n + 1.0);
+    EXPECT_EQ(bin, n);
+  }
+
+  EXPECT_EQ(grid->bin_count, count);
+  EXPECT_GE(grid->bin_max_count, count);
+  // The table is kept at most half full
+  EXPECT_GE(grid->slot_mask + 1, 2 * grid->bin_max_count);
+
+  for (int n = 0; n < count; n++) {
+    EXPECT_DOUBLE_EQ(
+      pf_hashgrid_get_prob(grid, cellPose(grid, n % 10, (n / 10) % 10, n / 100)), n + 1.0);
+  }
+
+  pf_hashgrid_free(grid);
+}
+
+TEST(PfHashgrid, ClustersMatchConnectedComponents)
+{
+  Xoshiro256 rng(17);
+
+  for (int trial = 0; trial < 50; trial++) {
+    pf_hashgrid_t * grid = pf_hashgrid_alloc(8);
+
+    // Sparse to dense random bins in a small box, so that both isolated bins
+    // and large clusters occur, including negative keys
+    const double density = 0.02 + 0.3 * rng.uniform();
+    std::vector<pf_vector_t> poses;
+    for (int k = -3; k < 3; k++) {
+      for (int j = -6; j < 6; j++) {
+        for (int i = -6; i < 6; i++) {
+          if (rng.uniform() < density) {
+            poses.push_back(cellPose(grid, i, j, k));
+          }
+        }
+      }
+    }
+
+    // Insert in random order, so bins aren't numbered in grid order
+    for (size_t n = poses.size(); n > 1; n--) {
+      std::swap(poses[n - 1], poses[rng() % n]);
+    }
+    for (const pf_vector_t & pose : poses) {
+      pf_hashgrid_insert(grid, pose, 1.0);
+    }
+
+    std::vector<int> expected = bruteForceClusters(grid);
+    int cluster_count = pf_hashgrid_cluster(grid);
+
+    int expected_count = 0;
+    for (int n = 0; n < grid->bin_count; n++) {
+      expected_count = std::max(expected_count, expected[n] + 1);
+      ASSERT_EQ(grid->bins[n].cluster, expected[n]) << "trial " << trial << ", bin " << n;
+    }
+    EXPECT_EQ(cluster_count, expected_count) << "trial " << trial;
+
+    pf_hashgrid_free(grid);
+  }
+}
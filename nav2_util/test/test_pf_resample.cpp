@@ -0,0 +1,108 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include "nav2_util/pf/pf.hpp"
+#include "gtest/gtest.h"
+
+namespace
+{
+
+pf_vector_t zeroPose(void *)
+{
+  return pf_vector_zero();
+}
+
+}  // namespace
+
+TEST(PfResample, AliasDrawsFollowWeights)
+{
+  const int n = 40;
+  pf_t * pf = pf_alloc(10, n, 0.001, 0.1, zeroPose, NULL);
+  srand48(23);
+
+  // Uneven weights, a fifth of them zero, not normalized
+  pf_sample_set_t * set = pf->sets + pf->current_set;
+  set->sample_count = n;
+  double total = 0.0;
+  for (int i = 0; i < n; i++) {
+    set->weight[i] = (i % 5 == 0) ? 0.0 : 1.0 + (i % 7) * (i % 3);
+    total += set->weight[i];
+  }
+
+  pf_build_alias_table(pf, set);
+
+  const int draws = 1000000;
+  std::vector<int> counts(n, 0);
+  for (int d = 0; d < draws; d++) {
+    int i = pf_draw_alias_sample(pf, n);
+    ASSERT_GE(i, 0);
+    ASSERT_LT(i, n);
+    counts[i]++;
+  }
+
+  for (int i = 0; i < n; i++) {
+    const double p = set->weight[i] / total;
+    if (p == 0.0) {
+      EXPECT_EQ(counts[i], 0) << "sample " << i;
+      continue;
+    }
+    // Within five standard deviations of the binomial count
+    const double sigma = sqrt(draws * p * (1.0 - p));
+    EXPECT_NEAR(counts[i], draws * p, 5.0 * sigma) << "sample " << i;
+  }
+
+  pf_free(pf);
+}
+
+TEST(PfResample, AliasDrawsSingleWeight)
+{
+  const int n = 25;
+  pf_t * pf = pf_alloc(10, n, 0.001, 0.1, zeroPose, NULL);
+  srand48(5);
+
+  pf_sample_set_t * set = pf->sets + pf->current_set;
+  set->sample_count = n;
+  for (int i = 0; i < n; i++) {
+    set->weight[i] = i == 17 ? 1.0 : 0.0;
+  }
+
+  pf_build_alias_table(pf, set);
+  for (int d = 0; d < 10000; d++) {
+    ASSERT_EQ(pf_draw_alias_sample(pf, n), 17);
+  }
+
+  pf_free(pf);
+}
+
+TEST(PfResample, LimitCacheMatchesResampleLimit)
+{
+  const int max_samples = 5000;
+  pf_t * pf = pf_alloc(100, max_samples, 0.001, 0.1, zeroPose, NULL);
+
+  const double params[][2] = {{0.01, 0.99}, {0.05, 0.99}, {0.05, 3.0}};
+  for (const auto & param : params) {
+    pf->pop_err = param[0];
+    pf->pop_z = param[1];
+    pf_update_limit_cache(pf);
+    for (int k = 0; k <= max_samples; k++) {
+      ASSERT_EQ(pf->limit_cache[k], pf_resample_limit(pf, k)) <<
+        "pop_err " << param[0] << ", pop_z " << param[1] << ", k " << k;
+    }
+  }
+
+  pf_free(pf);
+}
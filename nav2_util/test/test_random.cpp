@@ -0,0 +1,68 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_util/random.hpp"
+#include <vector>
+#include "gtest/gtest.h"
+
+using nav2_util::Xoshiro256;
+
+TEST(Xoshiro256, SeedReproducesStream)
+{
+  Xoshiro256 a(42), b(42), c(43);
+  bool differs = false;
+  for (int i = 0; i < 100; i++) {
+    uint64_t va = a();
+    EXPECT_EQ(va, b());
+    differs |= va != c();
+  }
+  EXPECT_TRUE(differs);
+
+  a.seed(7);
+  b.seed(7);
+  b.jump();
+  EXPECT_NE(a(), b());
+}
+
+TEST(Xoshiro256, UniformRange)
+{
+  Xoshiro256 rng(1);
+  double sum = 0.0;
+  const int n = 100000;
+  for (int i = 0; i < n; i++) {
+    double u = rng.uniform();
+    ASSERT_GE(u, 0.0);
+    ASSERT_LT(u, 1.0);
+    sum += u;
+  }
+  EXPECT_NEAR(sum / n, 0.5, 0.01);
+}
+
+TEST(Xoshiro256, GaussianMoments)
+{
+  Xoshiro256 rng(2);
+  // An odd count checks that the last unpaired value is filled too
+  std::vector<double> values(100001, 1e9);
+  rng.gaussian(values.data(), values.size());
+
+  double sum = 0.0, sum_sq = 0.0;
+  for (double v : values) {
+    ASSERT_LT(v, 1e8);
+    sum += v;
+    sum_sq += v * v;
+  }
+  double mean = sum / values.size();
+  EXPECT_NEAR(mean, 0.0, 0.02);
+  EXPECT_NEAR(sum_sq / values.size() - mean * mean, 1.0, 0.02);
+}
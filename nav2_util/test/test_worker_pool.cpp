@@ -0,0 +1,64 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_util/worker_pool.hpp"
+#include <vector>
+#include "gtest/gtest.h"
+
+using nav2_util::WorkerPool;
+
+TEST(WorkerPool, CoversRangeOnce)
+{
+  WorkerPool pool(4);
+  ASSERT_EQ(pool.size(), 4u);
+
+  std::vector<int> hits(1001, 0);
+  for (int repeat = 0; repeat < 50; repeat++) {
+    unsigned int lanes = pool.run(hits.size(),
+        [&hits](unsigned int, int begin, int end) {
+          for (int i = begin; i < end; i++) {
+            hits[i]++;
+          }
+        });
+    EXPECT_EQ(lanes, 4u);
+  }
+  for (int count : hits) {
+    EXPECT_EQ(count, 50);
+  }
+}
+
+TEST(WorkerPool, DeterministicShards)
+{
+  WorkerPool pool(3);
+  std::vector<int> begins(3, -1);
+  std::vector<int> ends(3, -1);
+  pool.run(10, [&](unsigned int lane, int begin, int end) {
+      begins[lane] = begin;
+      ends[lane] = end;
+    });
+  for (unsigned int lane = 0; lane < 3; lane++) {
+    EXPECT_EQ(begins[lane], WorkerPool::shardBegin(10, lane, 3));
+    EXPECT_EQ(ends[lane], WorkerPool::shardBegin(10, lane + 1, 3));
+  }
+  EXPECT_EQ(ends[2], 10);
+}
+
+TEST(WorkerPool, SmallRangesStaySerial)
+{
+  WorkerPool pool(4);
+  EXPECT_EQ(pool.run(0, [](unsigned int, int, int) {}), 0u);
+  EXPECT_EQ(pool.run(2, [](unsigned int, int, int) {}), 2u);
+  EXPECT_EQ(pool.run(100, [](unsigned int, int, int) {}, 64), 1u);
+  EXPECT_EQ(pool.run(200, [](unsigned int, int, int) {}, 64), 3u);
+}